@@ -0,0 +1,186 @@
+// Measures the spacing of a simulated server tick while V8 collects garbage
+// concurrently, with the thread layouts server_cpus and platform_cpus select:
+// first with every thread free to move, then with the tick thread on cpu 0
+// and the platform workers on the other cpus.
+//
+//   cmake -S . -B build -DSAMPNODE_BENCHMARKS=ON -DCMAKE_BUILD_TYPE=Release
+//   cmake --build build --target gc-jitter-bench
+//   ./build/bench/gc-jitter-bench [seconds per layout]
+//
+// Each tick runs a script that allocates like a busy gamemode and keeps a
+// share of it, so the old space keeps growing into concurrent marking. Then
+// the tick drains the platform tasks and sleeps like the server does. Run
+// several copies at once to see several server instances share a host.
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <memory>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "affinity.hpp"
+#include "node.h"
+#include "uv.h"
+#include "v8.h"
+
+using namespace sampnode;
+
+namespace {
+constexpr int kPlatformThreads = 4;
+constexpr auto kSleep = std::chrono::milliseconds(5);
+
+using Clock = std::chrono::steady_clock;
+
+const char *kWorkload = R"(
+(function () {
+  const kept = [];
+  return function tick() {
+    for (let i = 0; i < 2000; i++) {
+      const entry = {
+        id: i,
+        pos: [Math.random() * 6000, Math.random() * 6000, Math.random() * 100],
+        name: "player" + i,
+      };
+      if (i % 16 === 0) kept.push(entry);
+    }
+    // let the old generation go now and then, so major GCs keep coming
+    if (kept.length > 300000) kept.length = 0;
+  };
+})()
+)";
+
+struct Gc_t {
+  int count = 0;
+  int major = 0;
+};
+
+void on_gc(v8::Isolate *isolate, v8::GCType type, v8::GCCallbackFlags flags,
+           void *data) {
+  Gc_t *gc = static_cast<Gc_t *>(data);
+  gc->count++;
+  if (type & v8::kGCTypeMarkSweepCompact)
+    gc->major++;
+}
+
+double percentile(std::vector<double> values, double p) {
+  if (values.empty())
+    return 0;
+  size_t index = static_cast<size_t>(p * (values.size() - 1));
+  std::nth_element(values.begin(), values.begin() + index, values.end());
+  return values[index];
+}
+
+void run(const char *layout, v8::Isolate *isolate,
+         node::MultiIsolatePlatform *platform, int seconds) {
+  v8::Isolate::Scope isolateScope(isolate);
+  v8::HandleScope handleScope(isolate);
+  v8::Local<v8::Context> context = v8::Context::New(isolate);
+  v8::Context::Scope contextScope(context);
+
+  v8::Local<v8::String> source =
+      v8::String::NewFromUtf8(isolate, kWorkload).ToLocalChecked();
+  v8::Local<v8::Function> tick = v8::Script::Compile(context, source)
+                                     .ToLocalChecked()
+                                     ->Run(context)
+                                     .ToLocalChecked()
+                                     .As<v8::Function>();
+
+  Gc_t gc;
+  isolate->AddGCPrologueCallback(on_gc, &gc);
+
+  std::vector<double> intervals;
+  auto end = Clock::now() + std::chrono::seconds(seconds);
+  auto last = Clock::now();
+  while (last < end) {
+    {
+      v8::HandleScope tickScope(isolate);
+      tick->Call(context, context->Global(), 0, nullptr).ToLocalChecked();
+    }
+    platform->DrainTasks(isolate);
+    std::this_thread::sleep_for(kSleep);
+
+    auto now = Clock::now();
+    intervals.push_back(
+        std::chrono::duration<double, std::milli>(now - last).count());
+    last = now;
+  }
+
+  isolate->RemoveGCPrologueCallback(on_gc, &gc);
+
+  double sum = 0, sumSq = 0;
+  for (double ms : intervals) {
+    sum += ms;
+    sumSq += ms * ms;
+  }
+  double mean = sum / intervals.size();
+  double variance = sumSq / intervals.size() - mean * mean;
+
+  std::printf("%s\n", layout);
+  std::printf("  %zu ticks, interval avg %.2f ms, jitter %.2f ms, "
+              "p99 %.2f ms, max %.2f ms\n",
+              intervals.size(), mean, variance > 0 ? std::sqrt(variance) : 0,
+              percentile(intervals, 0.99),
+              *std::max_element(intervals.begin(), intervals.end()));
+  std::printf("  %d GCs, %d of them major\n", gc.count, gc.major);
+}
+} // namespace
+
+int main(int argc, char **argv) {
+  int seconds = argc > 1 ? std::max(1, std::atoi(argv[1])) : 10;
+
+  auto init = node::InitializeOncePerProcess(
+      {argv[0]}, {node::ProcessInitializationFlags::kNoInitializeV8,
+                  node::ProcessInitializationFlags::kNoInitializeNodeV8Platform,
+                  node::ProcessInitializationFlags::kNoInitOpenSSL});
+  if (init->early_return() != 0)
+    return 1;
+
+  std::unique_ptr<node::MultiIsolatePlatform> platform =
+      node::MultiIsolatePlatform::Create(kPlatformThreads);
+  v8::V8::InitializePlatform(platform.get());
+  v8::V8::Initialize();
+
+  uv_loop_t loop;
+  uv_loop_init(&loop);
+  std::unique_ptr<node::ArrayBufferAllocator> allocator =
+      node::ArrayBufferAllocator::Create();
+  v8::Isolate *isolate =
+      node::NewIsolate(allocator.get(), &loop, platform.get());
+
+  run("shared layout: server any, platform any", isolate, platform.get(),
+      seconds);
+
+  int cpus = static_cast<int>(std::thread::hardware_concurrency());
+  if (cpus < 2) {
+    std::printf("split layout skipped, it needs at least 2 cpus\n");
+  } else {
+    std::vector<int> serverCpus = {0};
+    std::vector<int> platformCpus;
+    for (int cpu = 1; cpu < cpus; cpu++)
+      platformCpus.push_back(cpu);
+
+    bool serverPinned = affinity::pin_current_thread(serverCpus);
+    int workersPinned =
+        affinity::pin_platform_workers(platform.get(), platformCpus);
+    std::string layout = "split layout: server " +
+                         affinity::to_string(serverCpus) + ", platform " +
+                         affinity::to_string(platformCpus);
+    if (!serverPinned || workersPinned < kPlatformThreads)
+      layout += " (not every thread could be pinned)";
+    run(layout.c_str(), isolate, platform.get(), seconds);
+  }
+
+  platform->UnregisterIsolate(isolate);
+  isolate->Dispose();
+  // lets the platform's task handle finish closing
+  uv_run(&loop, UV_RUN_DEFAULT);
+  uv_loop_close(&loop);
+  v8::V8::Dispose();
+  v8::V8::DisposePlatform();
+  node::TearDownOncePerProcess();
+  return 0;
+}
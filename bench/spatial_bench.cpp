@@ -0,0 +1,141 @@
+// Times the spatial index with 1000 synthetic players against the plain loop
+// over every player a script would otherwise run, and checks both agree.
+//
+//   cmake -S . -B build -DSAMPNODE_BENCHMARKS=ON -DCMAKE_BUILD_TYPE=Release
+//   cmake --build build --target spatial-bench
+//   ./build/bench/spatial-bench
+//
+// It exits with 1 when the index and the loop disagree.
+
+#include <chrono>
+#include <cmath>
+#include <cstdint>
+#include <cstdio>
+#include <random>
+#include <string>
+#include <vector>
+
+#include "spatialgrid.hpp"
+
+using namespace sampnode::spatial;
+
+namespace {
+constexpr int kPlayers = 1000;
+constexpr int kRounds = 20;
+constexpr float kCellSize = 50.0f;
+
+using Clock = std::chrono::steady_clock;
+
+// keeps the results alive so the queries aren't optimized away
+volatile uint64_t sink = 0;
+
+// most players spread over the map, the rest crowded around a few spots
+std::vector<Entry_t> make_players() {
+  std::mt19937 rng(1234);
+  std::uniform_real_distribution<float> map(-3000.0f, 3000.0f);
+  std::uniform_real_distribution<float> height(0.0f, 100.0f);
+  std::normal_distribution<float> crowd(0.0f, 25.0f);
+  const float spots[][2] = {
+      {1480.0f, -1740.0f}, {-2000.0f, 150.0f}, {2030.0f, 1000.0f}};
+
+  std::vector<Entry_t> players;
+  for (int32_t id = 0; id < kPlayers; id++) {
+    Entry_t entry;
+    entry.id = id;
+    entry.world = id % 10 == 0 ? 1 + id % 3 : 0;
+    if (id % 4 == 0) {
+      const float *spot = spots[id % 3];
+      entry.x = spot[0] + crowd(rng);
+      entry.y = spot[1] + crowd(rng);
+    } else {
+      entry.x = map(rng);
+      entry.y = map(rng);
+    }
+    entry.z = height(rng);
+    players.push_back(entry);
+  }
+  return players;
+}
+
+uint32_t loop_in_radius(const std::vector<Entry_t> &players, const Entry_t &q,
+                        float r, int32_t *out) {
+  uint32_t found = 0;
+  for (const Entry_t &player : players) {
+    float dx = player.x - q.x, dy = player.y - q.y, dz = player.z - q.z;
+    if (player.world == q.world && dx * dx + dy * dy + dz * dz <= r * r)
+      out[found++] = player.id;
+  }
+  return found;
+}
+
+// nanoseconds per call of run, averaged over kRounds
+template <typename F> double time_ns(F &&run) {
+  auto start = Clock::now();
+  for (int round = 0; round < kRounds; round++)
+    run();
+  std::chrono::duration<double, std::nano> elapsed = Clock::now() - start;
+  return elapsed.count() / kRounds;
+}
+
+// nanoseconds per query when run queries once from every player
+template <typename F> double ns_per_query(F &&run) {
+  return time_ns(run) / kPlayers;
+}
+
+bool run(const char *kernel, const std::vector<Entry_t> &players) {
+  std::shared_ptr<const Index_t> index;
+  double buildUs =
+      time_ns([&] { index = build_index(players, kCellSize); }) / 1000;
+
+  std::vector<int32_t> out(kPlayers);
+  bool ok = true;
+
+  std::printf("%s kernel, %d players, cell size %.0f\n", kernel, kPlayers,
+              kCellSize);
+  std::printf("  build_index          %10.1f us per tick\n", buildUs);
+
+  for (float r : {20.0f, 50.0f, 200.0f}) {
+    double grid = ns_per_query([&] {
+      for (const Entry_t &q : players)
+        sink += find_in_radius(*index, q.x, q.y, q.z, r, q.world, out.data(),
+                               kPlayers);
+    });
+    double loop = ns_per_query([&] {
+      for (const Entry_t &q : players)
+        sink += loop_in_radius(players, q, r, out.data());
+    });
+    std::printf("  queryRadius r=%-5.0f %10.1f ns, loop %10.1f ns (%.1fx)\n", r,
+                grid, loop, loop / grid);
+
+    for (const Entry_t &q : players) {
+      uint32_t expected = loop_in_radius(players, q, r, out.data());
+      if (find_in_radius(*index, q.x, q.y, q.z, r, q.world, out.data(),
+                         kPlayers) != expected) {
+        std::printf("  mismatch for player %d, r=%.0f\n", q.id, r);
+        ok = false;
+        break;
+      }
+    }
+  }
+
+  for (size_t k : {1, 10}) {
+    double grid = ns_per_query([&] {
+      for (const Entry_t &q : players)
+        sink += find_nearest(*index, q.x, q.y, q.z, k, -1, out.data());
+    });
+    std::printf("  kNearest k=%-8zu %10.1f ns\n", k, grid);
+  }
+
+  return ok;
+}
+} // namespace
+
+int main() {
+  std::vector<Entry_t> players = make_players();
+  run("warm-up", players);
+  bool ok = run("scalar", players);
+  const char *kernel = select_kernel();
+  if (std::string(kernel) != "scalar")
+    ok = run(kernel, players) && ok;
+  return ok ? 0 : 1;
+}
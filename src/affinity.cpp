@@ -0,0 +1,143 @@
+#include "affinity.hpp"
+
+#include <chrono>
+#include <condition_variable>
+#include <memory>
+#include <mutex>
+#include <sstream>
+
+#ifdef _WIN32
+#include <windows.h>
+#elif defined(__linux__)
+#include <pthread.h>
+#include <sched.h>
+#endif
+
+#include "logger.hpp"
+
+namespace sampnode {
+namespace affinity {
+namespace {
+constexpr auto kRendezvousTimeout = std::chrono::seconds(1);
+
+// Every pool thread has to be parked here at the same time, otherwise a fast
+// thread could pick up more than one pin task and leave another one unpinned.
+struct Rendezvous_t {
+  explicit Rendezvous_t(int count) : remaining(count) {}
+
+  void arrive(bool ok) {
+    std::unique_lock<std::mutex> lock(mutex);
+    if (ok)
+      pinned++;
+    if (--remaining <= 0) {
+      cv.notify_all();
+      return;
+    }
+    cv.wait_for(lock, kRendezvousTimeout, [this] { return remaining <= 0; });
+  }
+
+  int wait() {
+    std::unique_lock<std::mutex> lock(mutex);
+    cv.wait_for(lock, kRendezvousTimeout, [this] { return remaining <= 0; });
+    return pinned;
+  }
+
+  std::mutex mutex;
+  std::condition_variable cv;
+  int remaining;
+  int pinned = 0;
+};
+
+class PinTask : public v8::Task {
+public:
+  PinTask(std::shared_ptr<Rendezvous_t> rendezvous, std::vector<int> cpus)
+      : rendezvous(std::move(rendezvous)), cpus(std::move(cpus)) {}
+
+  void Run() override { rendezvous->arrive(pin_current_thread(cpus)); }
+
+private:
+  std::shared_ptr<Rendezvous_t> rendezvous;
+  std::vector<int> cpus;
+};
+
+struct PinWork_t {
+  uv_work_t req;
+  std::shared_ptr<Rendezvous_t> rendezvous;
+  std::vector<int> cpus;
+};
+} // namespace
+
+bool pin_current_thread(const std::vector<int> &cpus) {
+  if (cpus.empty())
+    return true;
+
+#ifdef _WIN32
+  DWORD_PTR mask = 0;
+  for (int cpu : cpus) {
+    if (cpu >= 0 && cpu < static_cast<int>(sizeof(DWORD_PTR) * 8))
+      mask |= static_cast<DWORD_PTR>(1) << cpu;
+  }
+  return mask != 0 && SetThreadAffinityMask(GetCurrentThread(), mask) != 0;
+#elif defined(__linux__)
+  cpu_set_t set;
+  CPU_ZERO(&set);
+  for (int cpu : cpus) {
+    if (cpu >= 0 && cpu < CPU_SETSIZE)
+      CPU_SET(cpu, &set);
+  }
+  return CPU_COUNT(&set) != 0 &&
+         pthread_setaffinity_np(pthread_self(), sizeof(set), &set) == 0;
+#else
+  return false;
+#endif
+}
+
+int pin_platform_workers(v8::Platform *platform, const std::vector<int> &cpus) {
+  int count = platform->NumberOfWorkerThreads();
+  if (cpus.empty() || count <= 0)
+    return 0;
+
+  auto rendezvous = std::make_shared<Rendezvous_t>(count);
+  for (int i = 0; i < count; i++)
+    platform->CallOnWorkerThread(std::make_unique<PinTask>(rendezvous, cpus));
+  return rendezvous->wait();
+}
+
+int pin_uv_threadpool(uv_loop_t *loop, int size, const std::vector<int> &cpus) {
+  if (cpus.empty() || size <= 0)
+    return 0;
+
+  auto rendezvous = std::make_shared<Rendezvous_t>(size);
+  for (int i = 0; i < size; i++) {
+    auto work = new PinWork_t{{}, rendezvous, cpus};
+    work->req.data = work;
+
+    int err = uv_queue_work(
+        loop, &work->req,
+        [](uv_work_t *req) {
+          auto work = static_cast<PinWork_t *>(req->data);
+          work->rendezvous->arrive(pin_current_thread(work->cpus));
+        },
+        [](uv_work_t *req, int) { delete static_cast<PinWork_t *>(req->data); });
+
+    if (err != 0) {
+      L_ERROR << "could not queue uv threadpool affinity work: "
+              << uv_strerror(err);
+      delete work;
+      return 0;
+    }
+  }
+  return rendezvous->wait();
+}
+
+std::string to_string(const std::vector<int> &cpus) {
+  if (cpus.empty())
+    return "any";
+
+  std::ostringstream out;
+  for (size_t i = 0; i < cpus.size(); i++)
+    out << (i ? "," : "") << cpus[i];
+  return out.str();
+}
+} // namespace affinity
+} // namespace sampnode
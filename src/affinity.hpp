@@ -0,0 +1,22 @@
+#pragma once
+#include <string>
+#include <vector>
+
+#include "uv.h"
+#include "v8.h"
+
+namespace sampnode {
+namespace affinity {
+// Pins the calling thread to the given cpus. An empty list leaves the thread
+// alone and counts as success.
+bool pin_current_thread(const std::vector<int> &cpus);
+
+// Pool threads can't be addressed directly, so every thread of the pool is
+// handed one task that pins itself. Both block until all tasks ran (or a short
+// timeout passed) and return how many threads were pinned.
+int pin_platform_workers(v8::Platform *platform, const std::vector<int> &cpus);
+int pin_uv_threadpool(uv_loop_t *loop, int size, const std::vector<int> &cpus);
+
+std::string to_string(const std::vector<int> &cpus);
+} // namespace affinity
+} // namespace sampnode
@@ -4,15 +4,158 @@
 const std::string bootstrap = R"(
 const { pathToFileURL } = require("url");
 const { setDefaultResultOrder } = require("dns");
+const fs = require("fs");
+const nodeModule = require("module");
+
+// node keys the entries by content hash and version and recompiles stale ones
+function enableCompileCache(dir) {
+  if (!dir) return "disabled";
+  if (typeof nodeModule.enableCompileCache !== "function")
+    return "not supported by this Node.js version";
+
+  let warm = false;
+  try {
+    warm = fs.readdirSync(dir).length > 0;
+  } catch (e) {}
+
+  const { status, message, directory } = nodeModule.enableCompileCache(dir);
+  const { FAILED, DISABLED } = nodeModule.constants.compileCacheStatus;
+  if (status === FAILED) return "failed, " + message;
+  if (status === DISABLED) return "disabled by NODE_DISABLE_COMPILE_CACHE";
+  return (warm ? "warm" : "cold") + ", " + directory;
+}
 
 (async () => {
   setDefaultResultOrder("ipv4first");
+  const compileCache = enableCompileCache(__internal_resource.compileCacheDir);
   try {
     const entryPath = __internal_resource.entryFile;
     await import(pathToFileURL(entryPath).toString());
   } catch (e) {
     console.error(e);
   }
-  __internal_esmLoaded();
+  // the server is often killed rather than shut down, don't wait for exit
+  if (typeof nodeModule.flushCompileCache === "function")
+    nodeModule.flushCompileCache();
+  __internal_esmLoaded(compileCache);
 })();
-)";
\ No newline at end of file
+)";
+
+// Evaluates to a function that sends process.stdout/stderr and console.*
+// through write(level, text), levels numbered like samp.logprint. It only
+// uses globals, so it also runs in environments deserialized from a snapshot.
+const std::string consoleRouting = R"(
+(function (write, batchMs) {
+  const ERROR = 0, WARN = 1, DEBUG = 2, INFO = 3;
+  const methodLevels = {
+    log: INFO, info: INFO, debug: DEBUG, trace: DEBUG, warn: WARN, error: ERROR
+  };
+
+  // level of the console method that is writing, null for direct writes
+  let level = null;
+  // unterminated line per stream, written once its newline arrives
+  const partial = ["", ""];
+  // level, text pairs in the order they were written
+  let queued = [];
+  let timer = null;
+
+  function flush() {
+    if (timer !== null) {
+      clearTimeout(timer);
+      timer = null;
+    }
+    const entries = queued;
+    queued = [];
+    for (let i = 0; i < entries.length; i += 2)
+      write(entries[i], entries[i + 1]);
+  }
+
+  function emit(lineLevel, text) {
+    if (batchMs <= 0) {
+      write(lineLevel, text);
+      return;
+    }
+    const last = queued.length - 2;
+    if (last >= 0 && queued[last] === lineLevel)
+      queued[last + 1] += text;
+    else
+      queued.push(lineLevel, text);
+
+    if (queued.length >= 512) {
+      flush();
+    } else if (timer === null) {
+      timer = setTimeout(flush, batchMs);
+      timer.unref();
+    }
+  }
+
+  function route(stream, index, streamLevel) {
+    stream.write = function (chunk, encoding, callback) {
+      if (typeof encoding === "function") callback = encoding;
+      let text = typeof chunk === "string" ? chunk :
+        Buffer.from(chunk.buffer, chunk.byteOffset, chunk.byteLength).toString();
+
+      text = partial[index] + text;
+      const end = text.lastIndexOf("\n") + 1;
+      partial[index] = text.slice(end);
+      if (end > 0)
+        emit(level === null ? streamLevel : level, text.slice(0, end));
+
+      if (typeof callback === "function") process.nextTick(callback);
+      return true;
+    };
+    // the log file is no terminal, keep escape codes out of inspected values
+    stream.hasColors = () => false;
+    stream.getColorDepth = () => 1;
+  }
+
+  route(process.stdout, 0, INFO);
+  route(process.stderr, 1, ERROR);
+
+  for (const name of Object.keys(methodLevels)) {
+    const original = console[name];
+    console[name] = function (...args) {
+      const outer = level;
+      level = methodLevels[name];
+      try {
+        return original.apply(this, args);
+      } finally {
+        level = outer;
+      }
+    };
+  }
+
+  process.on("exit", () => {
+    if (partial[0]) emit(INFO, partial[0] + "\n");
+    if (partial[1]) emit(ERROR, partial[1] + "\n");
+    partial[0] = partial[1] = "";
+    flush();
+  });
+})
+)";
+
+// Evaluates to a function that makes DNS lookups prefer IPv4 like the
+// bootstrap does, for environments deserialized from a snapshot, which don't
+// run the bootstrap.
+const std::string dnsResultOrder = R"(
+(function () {
+  if (typeof process.getBuiltinModule === "function")
+    process.getBuiltinModule("dns").setDefaultResultOrder("ipv4first");
+})
+)";
+
+// Evaluates to a function that passes Buffer's zero-fill toggle to set. It
+// is a Uint32Array over a flag in node's allocator, cleared while
+// Buffer.allocUnsafe allocates. Nothing is passed when the binding is not
+// reachable, e.g. with the permission model.
+const std::string zeroFillToggle = R"(
+(function (set) {
+  let toggle;
+  try {
+    toggle = process.binding("buffer").getZeroFillToggle();
+  } catch (e) {
+    return;
+  }
+  if (toggle instanceof Uint32Array) set(toggle);
+})
+)";
@@ -6,89 +6,85 @@
 #include "amx/amx.h"
 #include "amxhandler.hpp"
 #include "events.hpp"
+#include "jsthread.hpp"
 #include "logger.hpp"
+#include "nodeimpl.hpp"
 #include "resource.hpp"
 #include "sampgdk.h"
+#include "trace.hpp"
+#include "watchdog.hpp"
 
 namespace sampnode {
 bool js_calling_public = false;
 
-int callback::execute_amx_call(v8::Isolate *isolate, const std::string &name,
-                               const std::string &format,
-                               const v8::FunctionCallbackInfo<v8::Value> &info,
-                               v8::Local<v8::Context> &context) {
+bool callback::prepare(v8::Isolate *isolate,
+                       const v8::FunctionCallbackInfo<v8::Value> &info,
+                       v8::Local<v8::Context> &context, PublicCall_t &call) {
+  v8::String::Utf8Value str(isolate, info[0]);
+  call.name = *str;
+
+  v8::String::Utf8Value str2(isolate, info[1]);
+  call.format = *str2;
+
+  const std::string &name = call.name;
+  const std::string &format = call.format;
+  call.params.resize(format.length());
+
   int k = 2;
-  cell _params[32];
-  std::vector<void *> params;
-  int numberOfStrings = 0;
-  int arraySizes[32];
+  for (size_t i = 0; i < format.length(); i++) {
+    PublicParam_t &param = call.params[i];
 
-  for (int i = 0; i < static_cast<int>(format.length()); i++) {
     switch (format[i]) {
     case 'i':
     case 'd': {
-      _params[i] = info[k]->Int32Value(context).ToChecked();
-      params.push_back(static_cast<void *>(&_params[i]));
+      param.value = info[k]->Int32Value(context).ToChecked();
       k++;
     } break;
     case 'f': {
       float val = 0.0f;
       if (!info[k]->IsUndefined())
         val = static_cast<float>(info[k]->NumberValue(context).ToChecked());
-      _params[i] = amx_ftoc(val);
-      params.push_back(static_cast<void *>(&_params[i]));
+      param.value = amx_ftoc(val);
       k++;
     } break;
     case 's': {
       v8::String::Utf8Value _str(isolate, info[k]);
-      const char *str(*_str);
-      size_t slen = std::char_traits<char>::length(str);
-      char *mystr = new char[slen + 1];
-      std::copy(str, str + slen, mystr);
-      mystr[slen] = '\0';
-      params.push_back(static_cast<void *>(mystr));
-      numberOfStrings++;
+      param.string = *_str;
       k++;
     } break;
     case 'a': {
       if (!info[k]->IsArray()) {
         L_ERROR << "callPublic: '" << name << "', parameter " << k
                 << "must be an array";
-        return 0;
+        return false;
       }
       v8::Local<v8::Array> a = v8::Local<v8::Array>::Cast(info[k]);
       size_t size = a->Length();
-      cell *value = new cell[size];
+      param.array.resize(size);
       for (size_t b = 0; b < size; b++) {
-        value[b] = a->Get(context, b)
-                       .ToLocalChecked()
-                       ->Int32Value(context)
-                       .ToChecked();
+        param.array[b] = a->Get(context, b)
+                             .ToLocalChecked()
+                             ->Int32Value(context)
+                             .ToChecked();
       }
-      params.push_back(static_cast<void *>(value));
-      arraySizes[i] = size;
-      numberOfStrings++;
       k++;
     } break;
     case 'v': {
       if (!info[k]->IsArray()) {
         L_ERROR << "callPublic: '" << name << "', parameter " << k
                 << "must be an array";
-        return 0;
+        return false;
       }
       v8::Local<v8::Array> a = v8::Local<v8::Array>::Cast(info[k]);
       size_t size = a->Length();
-      cell *value = new cell[size];
+      param.array.resize(size);
       for (size_t b = 0; b < size; b++) {
         float val = static_cast<float>(a->Get(context, b)
                                            .ToLocalChecked()
                                            ->NumberValue(context)
                                            .ToChecked());
-        value[b] = amx_ftoc(val);
+        param.array[b] = amx_ftoc(val);
       }
-      params.push_back(static_cast<void *>(value));
-      arraySizes[i] = size;
-      numberOfStrings++;
       k++;
     } break;
     default:
@@ -96,16 +92,26 @@ int callback::execute_amx_call(v8::Isolate *isolate, const std::string &name,
     }
   }
 
-  std::vector<cell> amx_addr;
-  for (int i = 0; i < numberOfStrings; i++) {
-    amx_addr.push_back(0);
+  return true;
+}
+
+int callback::invoke(const PublicCall_t &call) {
+  trace::Span span(trace::Category::Public, call.name.c_str());
+  const std::string &format = call.format;
+
+  int numberOfStrings = 0;
+  for (char c : format) {
+    if (c == 's' || c == 'a' || c == 'v')
+      numberOfStrings++;
   }
+
+  std::vector<cell> amx_addr(numberOfStrings, 0);
   numberOfStrings = 0;
 
   int returnValue = 0;
   for (auto &amx : amx::amx_list) {
     int callback = 0;
-    if (amx_FindPublic(amx.second->get(), name.c_str(), &callback)) {
+    if (amx_FindPublic(amx.second->get(), call.name.c_str(), &callback)) {
       continue;
     }
 
@@ -114,35 +120,29 @@ int callback::execute_amx_call(v8::Isolate *isolate, const std::string &name,
     }
 
     for (int i = format.length() - 1; i >= 0; i--) {
+      const PublicParam_t &param = call.params[i];
+
       switch (format[i]) {
       case 'd':
-      case 'i': {
-        amx_Push(amx.second->get(), *reinterpret_cast<cell *>(params[i]));
-        break;
-      }
+      case 'i':
       case 'f': {
-        amx_Push(amx.second->get(), *reinterpret_cast<cell *>(params[i]));
+        amx_Push(amx.second->get(), param.value);
         break;
       }
       case 's': {
-        char *string = static_cast<char *>(params[i]);
-        if (string != nullptr && std::char_traits<char>::length(string) > 0) {
-          amx_PushString(amx.second->get(), &amx_addr[numberOfStrings], nullptr,
-                         string, 0, 0);
-        } else {
-          *string = 1;
-          *(string + 1) = '\0';
-          amx_PushString(amx.second->get(), &amx_addr[numberOfStrings], nullptr,
-                         string, 0, 0);
-        }
+        // pawn can't take a zero length string, pass "\1" like the server does
+        const char *string =
+            param.string.empty() ? "\1" : param.string.c_str();
+        amx_PushString(amx.second->get(), &amx_addr[numberOfStrings], nullptr,
+                       string, 0, 0);
         numberOfStrings++;
         break;
       }
       case 'a':
       case 'v': {
-        cell *amxArray = static_cast<cell *>(params[i]);
         amx_PushArray(amx.second->get(), &amx_addr[numberOfStrings], nullptr,
-                      amxArray, arraySizes[i]);
+                      param.array.data(),
+                      static_cast<int>(param.array.size()));
         numberOfStrings++;
       } break;
       default:
@@ -161,15 +161,6 @@ int callback::execute_amx_call(v8::Isolate *isolate, const std::string &name,
     }
   }
 
-  for (auto &param : params) {
-    if (format[&param - &params[0]] == 's') {
-      delete[] static_cast<char *>(param);
-    } else if (format[&param - &params[0]] == 'a' ||
-               format[&param - &params[0]] == 'v') {
-      delete[] static_cast<cell *>(param);
-    }
-  }
-
   return returnValue;
 }
 
@@ -182,13 +173,18 @@ void callback::call(const v8::FunctionCallbackInfo<v8::Value> &info) {
   v8::TryCatch eh(isolate);
 
   if (info.Length() > 0) {
-    v8::String::Utf8Value str(isolate, info[0]);
-    std::string name(*str);
-
-    v8::String::Utf8Value str2(isolate, info[1]);
-    std::string format(*str2);
+    if (jsThread.IsActive()) {
+      jsThread.CallPublic(info, false);
+      return;
+    }
 
-    int returnValue = execute_amx_call(isolate, name, format, info, context);
+    PublicCall_t call;
+    int returnValue = 0;
+    if (prepare(isolate, info, context, call)) {
+      watchdog::Scope watchdogScope(watchdog::Kind::Public, call.name.c_str());
+      nodeImpl.RunOnServerThread(
+          [&call, &returnValue] { returnValue = invoke(call); });
+    }
     info.GetReturnValue().Set(returnValue);
   } else {
     info.GetReturnValue().Set(0);
@@ -204,16 +200,21 @@ void callback::call_float(const v8::FunctionCallbackInfo<v8::Value> &info) {
   v8::TryCatch eh(isolate);
 
   if (info.Length() > 0) {
-    v8::String::Utf8Value str(isolate, info[0]);
-    std::string name(*str);
-
-    v8::String::Utf8Value str2(isolate, info[1]);
-    std::string format(*str2);
+    if (jsThread.IsActive()) {
+      jsThread.CallPublic(info, true);
+      return;
+    }
 
-    int returnValue = execute_amx_call(isolate, name, format, info, context);
+    PublicCall_t call;
+    int returnValue = 0;
+    if (prepare(isolate, info, context, call)) {
+      watchdog::Scope watchdogScope(watchdog::Kind::Public, call.name.c_str());
+      nodeImpl.RunOnServerThread(
+          [&call, &returnValue] { returnValue = invoke(call); });
+    }
     info.GetReturnValue().Set(amx_ctof(returnValue));
   } else {
     info.GetReturnValue().Set(0.0f);
   }
 }
-} // namespace sampnode
\ No newline at end of file
+} // namespace sampnode
@@ -1,4 +1,7 @@
 #pragma once
+#include <string>
+#include <vector>
+
 #include "amx/amx.h"
 #include "node.h"
 #include "v8.h"
@@ -11,15 +14,28 @@ public:
     std::string param_types;
   };
 
+  struct PublicParam_t {
+    cell value = 0;
+    std::string string;
+    std::vector<cell> array;
+  };
+
+  // A public call with its arguments copied out of V8, so it can be executed
+  // on the server thread after the JS side has moved on.
+  struct PublicCall_t {
+    std::string name;
+    std::string format;
+    std::vector<PublicParam_t> params;
+  };
+
   static void call(const v8::FunctionCallbackInfo<v8::Value> &info);
   static void call_float(const v8::FunctionCallbackInfo<v8::Value> &info);
 
-private:
-  static int execute_amx_call(v8::Isolate *isolate, const std::string &name,
-                              const std::string &format,
-                              const v8::FunctionCallbackInfo<v8::Value> &info,
-                              v8::Local<v8::Context> &context);
+  static bool prepare(v8::Isolate *isolate,
+                      const v8::FunctionCallbackInfo<v8::Value> &info,
+                      v8::Local<v8::Context> &context, PublicCall_t &call);
+  static int invoke(const PublicCall_t &call);
 };
 
 extern bool js_calling_public;
-} // namespace sampnode
\ No newline at end of file
+} // namespace sampnode
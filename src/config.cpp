@@ -36,10 +36,71 @@ bool Config::ParseJsonFile(const std::string &path) {
 }
 
 Props_t Config::ReadAsMainConfig() {
-  return Props_t{get_as<std::string>("entry_file"),
-                 get_as<std::vector<std::string>>("node_flags"),
-                 static_cast<LogLevel>(get_as<int>("log_level")),
-                 get_as<std::string>("timestamp_format")};
+  Props_t props;
+  props.entry_file = get_as<std::string>("entry_file");
+  props.node_flags = get_as<std::vector<std::string>>("node_flags");
+  props.log_level = static_cast<LogLevel>(get_as<int>("log_level"));
+  props.timestamp_format = get_as<std::string>("timestamp_format");
+  props.threaded_runtime = get_as<bool>("threaded_runtime");
+  props.async_events = get_as<std::vector<std::string>>("async_events");
+  props.sync_event_timeout =
+      get_or<int>(props.sync_event_timeout, "sync_event_timeout");
+  props.platform_threads =
+      get_or<int>(props.platform_threads, "platform_threads");
+  props.uv_threadpool_size =
+      get_or<int>(props.uv_threadpool_size, "uv_threadpool_size");
+  props.server_cpus = get_as<std::vector<int>>("server_cpus");
+  props.platform_cpus = get_as<std::vector<int>>("platform_cpus");
+  props.compile_cache_dir = get_as<std::string>("compile_cache_dir");
+  props.snapshot_blob = get_as<std::string>("snapshot_blob");
+  props.snapshot_builder = get_as<std::string>("snapshot_builder");
+  props.background_init = get_as<bool>("background_init");
+  props.idle_gc_budget_ms =
+      get_or<int>(props.idle_gc_budget_ms, "idle_gc_budget_ms");
+  props.tick_overrun_ms = get_or<int>(props.tick_overrun_ms, "tick_overrun_ms");
+  props.hibernate = get_as<bool>("hibernate");
+  props.hibernate_delay_ms =
+      get_or<int>(props.hibernate_delay_ms, "hibernate_delay_ms");
+  props.hibernate_tick_ms =
+      get_or<int>(props.hibernate_tick_ms, "hibernate_tick_ms");
+  props.array_buffer_pool = get_as<bool>("array_buffer_pool");
+  props.array_buffer_pool_cache_kb = get_or<int>(
+      props.array_buffer_pool_cache_kb, "array_buffer_pool_cache_kb");
+  props.profile_sampling_us =
+      get_or<int>(props.profile_sampling_us, "profile_sampling_us");
+  props.profile_tick_threshold_ms =
+      get_or<int>(props.profile_tick_threshold_ms, "profile_tick_threshold_ms");
+  props.profile_tick_count =
+      get_or<int>(props.profile_tick_count, "profile_tick_count");
+  props.profile_duration_ms =
+      get_or<int>(props.profile_duration_ms, "profile_duration_ms");
+  props.profile_cooldown_ms =
+      get_or<int>(props.profile_cooldown_ms, "profile_cooldown_ms");
+  props.watchdog_timeout_ms =
+      get_or<int>(props.watchdog_timeout_ms, "watchdog_timeout_ms");
+  props.watchdog_terminate = get_as<bool>("watchdog_terminate");
+  props.watchdog_retval = get_or<int>(props.watchdog_retval, "watchdog_retval");
+  props.perf_stats = get_as<bool>("perf_stats");
+  props.perf_stats_file = get_as<std::string>("perf_stats_file");
+  props.perf_stats_file_kb =
+      get_or<int>(props.perf_stats_file_kb, "perf_stats_file_kb");
+  props.perf_stats_interval_ms =
+      get_or<int>(props.perf_stats_interval_ms, "perf_stats_interval_ms");
+  props.trace_buffer_size =
+      get_or<int>(props.trace_buffer_size, "trace_buffer_size");
+  props.heap_limit_snapshot =
+      get_or<bool>(props.heap_limit_snapshot, "heap_limit_snapshot");
+  props.log_queue_size = get_or<int>(props.log_queue_size, "log_queue_size");
+  props.console_to_log = get_as<bool>("console_to_log");
+  props.console_batch_ms =
+      get_or<int>(props.console_batch_ms, "console_batch_ms");
+  props.error_dedup_window_ms =
+      get_or<int>(props.error_dedup_window_ms, "error_dedup_window_ms");
+  props.player_mirror = get_as<bool>("player_mirror");
+  props.spatial_index = get_as<bool>("spatial_index");
+  props.spatial_cell_size =
+      get_or<float>(props.spatial_cell_size, "spatial_cell_size");
+  return props;
 }
 
 template <typename T, typename... args> T Config::get_as(const args &...keys) {
@@ -56,6 +117,21 @@ template <typename T, typename... args> T Config::get_as(const args &...keys) {
   return tempJsonObj.get<T>();
 }
 
+template <typename T, typename... args>
+T Config::get_or(const T &fallback, const args &...keys) {
+  std::vector<std::string> _keys = {keys...};
+
+  json tempJsonObj = jsonObject;
+  for (auto &key : _keys) {
+    if (!tempJsonObj[key].is_null()) {
+      tempJsonObj = tempJsonObj[key];
+    } else {
+      return fallback;
+    }
+  }
+  return tempJsonObj.get<T>();
+}
+
 Config::Config() {}
 
 Config::~Config() {}
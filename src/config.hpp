@@ -12,6 +12,45 @@ struct Props_t {
   std::vector<std::string> node_flags;
   LogLevel log_level = LogLevel::LOG_FULL;
   std::string timestamp_format = "%Y-%m-%dT%H:%M:%S%z";
+  bool threaded_runtime = false;
+  std::vector<std::string> async_events;
+  int sync_event_timeout = 50;
+  int platform_threads = 4;
+  int uv_threadpool_size = 0; // 0 keeps UV_THREADPOOL_SIZE or libuv's default
+  std::vector<int> server_cpus;
+  std::vector<int> platform_cpus;
+  std::string compile_cache_dir;
+  std::string snapshot_blob;
+  std::string snapshot_builder;
+  bool background_init = false;
+  int idle_gc_budget_ms = 0;
+  int tick_overrun_ms = 5;
+  bool hibernate = false;
+  int hibernate_delay_ms = 60000;
+  int hibernate_tick_ms = 100;
+  bool array_buffer_pool = false;
+  int array_buffer_pool_cache_kb = 1024;
+  int profile_sampling_us = 1000;
+  int profile_tick_threshold_ms = 0;
+  int profile_tick_count = 5;
+  int profile_duration_ms = 5000;
+  int profile_cooldown_ms = 60000;
+  int watchdog_timeout_ms = 0;
+  bool watchdog_terminate = false;
+  int watchdog_retval = 0;
+  bool perf_stats = false;
+  std::string perf_stats_file;
+  int perf_stats_file_kb = 1024;
+  int perf_stats_interval_ms = 1000;
+  int trace_buffer_size = 65536;
+  bool heap_limit_snapshot = true;
+  int log_queue_size = 8192;
+  bool console_to_log = false;
+  int console_batch_ms = 0;
+  int error_dedup_window_ms = 10000;
+  bool player_mirror = false;
+  bool spatial_index = false;
+  float spatial_cell_size = 50.0f;
 };
 
 class Config {
@@ -23,6 +62,8 @@ public:
   bool ParseJsonFile(const std::string &path);
 
   template <typename T, typename... args> T get_as(const args &...keys);
+  template <typename T, typename... args>
+  T get_or(const T &fallback, const args &...keys);
 
   Props_t ReadAsMainConfig();
 
@@ -0,0 +1,79 @@
+#include "deferred.hpp"
+
+#include "callbacks.hpp"
+#include "natives.hpp"
+#include "perfstats.hpp"
+
+namespace sampnode {
+namespace {
+struct DeferredNative_t : Deferred_t {
+  native::NativeCall_t call;
+  // perf stats, the wait in the queues is not counted
+  uint64_t prepareNs = 0;
+  uint64_t invokeNs = 0;
+
+  void Invoke() override {
+    uint64_t start = perfstats::enabled ? perfstats::now_ns() : 0;
+    native::invoke(call);
+    if (perfstats::enabled)
+      invokeNs = perfstats::now_ns() - start;
+  }
+
+  v8::Local<v8::Value> Result(v8::Isolate *isolate,
+                              v8::Local<v8::Context> context) override {
+    uint64_t start = perfstats::enabled ? perfstats::now_ns() : 0;
+    v8::Local<v8::Value> value = native::result(isolate, context, call);
+    if (asFloat)
+      value = native::to_float(isolate, context, value);
+
+    if (perfstats::enabled && call.native)
+      perfstats::native_counter(call.name)
+          ->record(invokeNs, prepareNs + (perfstats::now_ns() - start));
+    return value;
+  }
+};
+
+struct DeferredPublic_t : Deferred_t {
+  callback::PublicCall_t call;
+  int retval = 0;
+
+  void Invoke() override { retval = callback::invoke(call); }
+
+  v8::Local<v8::Value> Result(v8::Isolate *isolate,
+                              v8::Local<v8::Context> context) override {
+    if (asFloat)
+      return v8::Number::New(isolate, amx_ctof(retval));
+    return v8::Integer::New(isolate, retval);
+  }
+};
+} // namespace
+
+namespace deferred {
+std::unique_ptr<Deferred_t>
+native(const v8::FunctionCallbackInfo<v8::Value> &info, bool asFloat) {
+  v8::HandleScope scope(info.GetIsolate());
+
+  uint64_t start = perfstats::enabled ? perfstats::now_ns() : 0;
+  auto task = std::make_unique<DeferredNative_t>();
+  task->asFloat = asFloat;
+  if (!native::prepare(info, task->call))
+    return nullptr;
+  if (perfstats::enabled)
+    task->prepareNs = perfstats::now_ns() - start;
+  return task;
+}
+
+std::unique_ptr<Deferred_t>
+public_call(const v8::FunctionCallbackInfo<v8::Value> &info, bool asFloat) {
+  v8::Isolate *isolate = info.GetIsolate();
+  v8::HandleScope scope(isolate);
+  v8::Local<v8::Context> context = isolate->GetCurrentContext();
+
+  auto task = std::make_unique<DeferredPublic_t>();
+  task->asFloat = asFloat;
+  if (!callback::prepare(isolate, info, context, task->call))
+    return nullptr;
+  return task;
+}
+} // namespace deferred
+} // namespace sampnode
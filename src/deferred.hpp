@@ -0,0 +1,29 @@
+#pragma once
+#include <cstdint>
+#include <memory>
+
+#include "v8.h"
+
+namespace sampnode {
+// A native or public call (or other work on the server, like a state
+// snapshot) whose arguments were read from V8 on one thread and which is
+// invoked later on the server thread. The result is turned back into a V8
+// value on the thread that queued it.
+struct Deferred_t {
+  virtual ~Deferred_t() {}
+  virtual void Invoke() = 0;
+  virtual v8::Local<v8::Value> Result(v8::Isolate *isolate,
+                                      v8::Local<v8::Context> context) = 0;
+
+  uint64_t id = 0;
+  bool asFloat = false;
+};
+
+namespace deferred {
+// both return nullptr when the arguments are invalid
+std::unique_ptr<Deferred_t>
+native(const v8::FunctionCallbackInfo<v8::Value> &info, bool asFloat);
+std::unique_ptr<Deferred_t>
+public_call(const v8::FunctionCallbackInfo<v8::Value> &info, bool asFloat);
+} // namespace deferred
+} // namespace sampnode
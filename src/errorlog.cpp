@@ -0,0 +1,146 @@
+#include "errorlog.hpp"
+
+#include <chrono>
+#include <mutex>
+#include <unordered_map>
+
+#include "logger.hpp"
+
+namespace sampnode {
+namespace errorlog {
+namespace {
+using Clock = std::chrono::steady_clock;
+
+constexpr auto kSweepInterval = std::chrono::seconds(1);
+// a storm of distinct messages must not grow the table without bound
+constexpr size_t kMaxEntries = 1024;
+
+struct Entry_t {
+  std::string where;
+  std::string message;
+  std::string location;
+  Clock::time_point windowStart;
+  uint64_t suppressed = 0;
+};
+
+std::mutex mutex;
+std::unordered_map<std::string, Entry_t> entries;
+Clock::duration window = Clock::duration::zero();
+Clock::time_point lastSweep;
+
+void log_summary(const Entry_t &entry, Clock::time_point now) {
+  auto seconds =
+      std::chrono::duration_cast<std::chrono::seconds>(now - entry.windowStart)
+          .count();
+  L_ERROR << "Exception in " << entry.where << ": " << entry.message
+          << (entry.location.empty() ? "" : " at " + entry.location)
+          << " was thrown " << entry.suppressed << " more times in the last "
+          << seconds << "s";
+}
+
+// with the mutex held
+void sweep(Clock::time_point now, bool all) {
+  for (auto iter = entries.begin(); iter != entries.end();) {
+    Entry_t &entry = iter->second;
+    if (!all && now - entry.windowStart < window) {
+      ++iter;
+      continue;
+    }
+
+    if (entry.suppressed > 0)
+      log_summary(entry, now);
+    iter = entries.erase(iter);
+  }
+}
+} // namespace
+
+void init(const Props_t &config) {
+  std::lock_guard<std::mutex> lock(mutex);
+  window = std::chrono::milliseconds(config.error_dedup_window_ms);
+  lastSweep = Clock::now();
+}
+
+void shutdown() {
+  std::lock_guard<std::mutex> lock(mutex);
+  sweep(Clock::now(), true);
+}
+
+bool admit(const std::string &where, const std::string &message,
+           const std::string &location) {
+  if (window <= Clock::duration::zero())
+    return true;
+
+  std::string key;
+  key.reserve(where.size() + message.size() + location.size() + 2);
+  key.append(where).append(1, '\0').append(message).append(1, '\0').append(
+      location);
+
+  auto now = Clock::now();
+  std::lock_guard<std::mutex> lock(mutex);
+
+  auto iter = entries.find(key);
+  if (iter != entries.end() && now - iter->second.windowStart < window) {
+    iter->second.suppressed++;
+    return false;
+  }
+
+  if (iter == entries.end()) {
+    if (entries.size() >= kMaxEntries)
+      sweep(now, true);
+    iter = entries.emplace(std::move(key), Entry_t{}).first;
+    iter->second.where = where;
+    iter->second.message = message;
+    iter->second.location = location;
+  } else if (iter->second.suppressed > 0) {
+    log_summary(iter->second, now);
+  }
+
+  iter->second.windowStart = now;
+  iter->second.suppressed = 0;
+  return true;
+}
+
+std::string location(v8::Isolate *isolate, v8::Local<v8::Context> context,
+                     v8::Local<v8::Message> message) {
+  if (message.IsEmpty())
+    return std::string();
+
+  v8::String::Utf8Value script(isolate, message->GetScriptResourceName());
+  std::string result = *script ? *script : "<anonymous>";
+  result += ":" + std::to_string(message->GetLineNumber(context).FromMaybe(0));
+  result += ":" + std::to_string(message->GetStartColumn(context).FromMaybe(0));
+  return result;
+}
+
+void report(v8::Isolate *isolate, v8::Local<v8::Context> context,
+            const v8::TryCatch &eh, const std::string &where) {
+  v8::String::Utf8Value exception(isolate, eh.Exception());
+  std::string message = *exception ? *exception : "<unknown>";
+  if (!admit(where, message, location(isolate, context, eh.Message())))
+    return;
+
+  // values thrown that are no Error have no stack
+  v8::Local<v8::Value> stack;
+  if (eh.StackTrace(context).ToLocal(&stack) && stack->IsString()) {
+    v8::String::Utf8Value stackStr(isolate, stack);
+    L_ERROR << "Exception in " << where << ": " << message << "\nstack:\n"
+            << *stackStr;
+  } else {
+    L_ERROR << "Exception in " << where << ": " << message;
+  }
+}
+
+void on_tick() {
+  if (window <= Clock::duration::zero())
+    return;
+
+  auto now = Clock::now();
+  std::lock_guard<std::mutex> lock(mutex);
+  if (now - lastSweep < kSweepInterval)
+    return;
+
+  lastSweep = now;
+  sweep(now, false);
+}
+} // namespace errorlog
+} // namespace sampnode
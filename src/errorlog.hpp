@@ -0,0 +1,33 @@
+#pragma once
+#include <string>
+
+#include "config.hpp"
+#include "node.h"
+#include "v8.h"
+
+namespace sampnode {
+namespace errorlog {
+// Exceptions are keyed by where they were caught, their message and the
+// location they were thrown from. Within error_dedup_window_ms only the first
+// one of a key is logged with its stack, the rest are counted and summed up
+// in one line once the window has passed.
+void init(const Props_t &config);
+// logs the summaries that are still open
+void shutdown();
+
+// false when the key was already logged in its window, the report is counted
+// and nothing else needs to be built for it
+bool admit(const std::string &where, const std::string &message,
+           const std::string &location);
+// script:line:column the message points at, empty if it has none
+std::string location(v8::Isolate *isolate, v8::Local<v8::Context> context,
+                     v8::Local<v8::Message> message);
+
+// logs what eh caught while running `where` (an event, a native...)
+void report(v8::Isolate *isolate, v8::Local<v8::Context> context,
+            const v8::TryCatch &eh, const std::string &where);
+
+// summaries of windows that have passed, checked at most once a second
+void on_tick();
+} // namespace errorlog
+} // namespace sampnode
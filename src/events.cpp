@@ -4,21 +4,30 @@
 #include <vector>
 
 #include "amx/amx.h"
+#include "errorlog.hpp"
+#include "jsthread.hpp"
 #include "logger.hpp"
 #include "node.h"
 #include "nodeimpl.hpp"
 #include "plugincommon.h"
+#include "profiler.hpp"
+#include "trace.hpp"
 #include "utils.hpp"
+#include "watchdog.hpp"
 #include "uv.h"
 
 namespace sampnode {
 eventsContainer events = eventsContainer();
+std::mutex eventsMutex;
 
 int handlePromiseReturnValue(v8::Local<v8::Value> returnValue,
                              v8::Isolate *isolate) {
   if (returnValue->IsPromise()) {
     v8::Local<v8::Promise> promise = returnValue.As<v8::Promise>();
     while (true) {
+      // a terminated isolate runs no more JS, the promise would never settle
+      if (isolate->IsExecutionTerminating())
+        return 0;
       v8::Promise::PromiseState state = promise->State();
       if (state == v8::Promise::PromiseState::kPending) {
         sampnode::nodeImpl.Tick();
@@ -34,47 +43,42 @@ int handlePromiseReturnValue(v8::Local<v8::Value> returnValue,
   }
 }
 
-v8::Local<v8::Value> *convertAmxParamsToV8(AMX *amx, cell *params,
-                                           v8::Isolate *isolate,
-                                           v8::Local<v8::Context> ctx,
-                                           const std::string &paramTypes,
-                                           unsigned int &argc, int &paramOffset,
-                                           bool isFromPawnNative) {
-  argc = paramTypes.length();
-  v8::Local<v8::Value> *argv = new v8::Local<v8::Value>[argc];
-  paramOffset = 0;
+bool event::collect_args(AMX *amx, cell *params, bool isFromPawnNative,
+                         std::vector<EventArg_t> &args) {
+  const unsigned int argc = paramTypes.length();
+  args.resize(argc);
+  int paramOffset = 0;
 
   for (unsigned int i = 0; i < argc; i++) {
+    EventArg_t &arg = args[i];
+    arg.type = paramTypes[i];
+
     switch (paramTypes[i]) {
     case 's': {
       cell *maddr = NULL;
       int len = 0;
-      char *sval;
       if (amx_GetAddr(amx, params[i + paramOffset + 1], &maddr) !=
           AMX_ERR_NONE) {
         L_ERROR << "Can't get string address";
-        delete[] argv;
-        return nullptr;
+        return false;
       }
       amx_StrLen(maddr, &len);
-      sval = new char[len + 1];
-      if (amx_GetString(sval, maddr, 0, len + 1) != AMX_ERR_NONE) {
+      arg.string.resize(len + 1);
+      if (amx_GetString(&arg.string[0], maddr, 0, len + 1) != AMX_ERR_NONE) {
         L_ERROR << "Can't get string address";
-        delete[] argv;
-        delete[] sval;
-        return nullptr;
+        return false;
       }
-      argv[i] = v8::String::NewFromUtf8(isolate, sval).ToLocalChecked();
-      delete[] sval;
+      arg.string.resize(len);
       break;
     }
-    case 'a': {
+    case 'a':
+    case 'v': {
       cell *array = NULL;
       if (amx_GetAddr(amx, params[i + paramOffset + 1], &array) !=
           AMX_ERR_NONE) {
-        L_ERROR << "Can't get array address";
-        delete[] argv;
-        return nullptr;
+        L_ERROR << (paramTypes[i] == 'a' ? "Can't get array address"
+                                         : "Can't get float array address");
+        return false;
       }
       int size;
       if (isFromPawnNative) {
@@ -82,74 +86,78 @@ v8::Local<v8::Value> *convertAmxParamsToV8(AMX *amx, cell *params,
             *utils::get_amxaddr(amx, params[i + paramOffset + 2]));
       } else {
         size = params[i + 2];
-        L_INFO << "Array size: " << size;
+        if (paramTypes[i] == 'a')
+          L_DEBUG << "Array size: " << size;
       }
+      arg.array.assign(array, array + size);
+      paramOffset++;
+      break;
+    }
+    case 'd':
+    case 'i':
+    case 'f': {
+      if (isFromPawnNative) {
+        arg.value = *utils::get_amxaddr(amx, params[i + paramOffset + 1]);
+      } else {
+        arg.value = params[i + 1];
+      }
+      break;
+    }
+    }
+  }
+
+  return true;
+}
+
+std::vector<v8::Local<v8::Value>>
+convertArgsToV8(const std::vector<event::EventArg_t> &args,
+                v8::Isolate *isolate, v8::Local<v8::Context> ctx) {
+  std::vector<v8::Local<v8::Value>> argv(args.size());
+
+  for (size_t i = 0; i < args.size(); i++) {
+    const event::EventArg_t &arg = args[i];
+
+    switch (arg.type) {
+    case 's': {
+      argv[i] = v8::String::NewFromUtf8(isolate, arg.string.c_str())
+                    .ToLocalChecked();
+      break;
+    }
+    case 'a': {
+      int size = static_cast<int>(arg.array.size());
       v8::Local<v8::Array> jsArray = v8::Array::New(isolate, size);
       for (int j = 0; j < size; j++) {
         jsArray
             ->Set(ctx, j,
-                  v8::Integer::New(isolate, static_cast<uint32_t>(array[j])))
+                  v8::Integer::New(isolate,
+                                   static_cast<uint32_t>(arg.array[j])))
             .Check();
       }
       argv[i] = jsArray;
-      paramOffset++;
       break;
     }
     case 'v': {
-      cell *array = NULL;
-      if (amx_GetAddr(amx, params[i + paramOffset + 1], &array) !=
-          AMX_ERR_NONE) {
-        L_ERROR << "Can't get float array address";
-        delete[] argv;
-        return nullptr;
-      }
-
-      int size;
-      if (isFromPawnNative) {
-        size = static_cast<int>(
-            *utils::get_amxaddr(amx, params[i + paramOffset + 2]));
-      } else {
-        size = params[i + 2];
-      }
+      int size = static_cast<int>(arg.array.size());
       v8::Local<v8::Array> jsArray = v8::Array::New(isolate, size);
       for (int j = 0; j < size; j++) {
-        jsArray->Set(ctx, j, v8::Integer::New(isolate, amx_ctof(array[j])))
+        cell value = arg.array[j];
+        jsArray->Set(ctx, j, v8::Integer::New(isolate, amx_ctof(value)))
             .Check();
       }
       argv[i] = jsArray;
-      paramOffset++;
       break;
     }
     case 'd': {
-      int32_t value;
-      if (isFromPawnNative) {
-        value = static_cast<int32_t>(
-            *utils::get_amxaddr(amx, params[i + paramOffset + 1]));
-      } else {
-        value = static_cast<int32_t>(params[i + 1]);
-      }
-      argv[i] = v8::Integer::New(isolate, value);
+      argv[i] = v8::Integer::New(isolate, static_cast<int32_t>(arg.value));
       break;
     }
     case 'i': {
-      uint32_t value;
-      if (isFromPawnNative) {
-        value = static_cast<uint32_t>(
-            *utils::get_amxaddr(amx, params[i + paramOffset + 1]));
-      } else {
-        value = static_cast<uint32_t>(params[i + 1]);
-      }
-      argv[i] = v8::Integer::New(isolate, value);
+      argv[i] = v8::Integer::New(isolate, static_cast<uint32_t>(arg.value));
       break;
     }
     case 'f': {
-      float value;
-      if (isFromPawnNative) {
-        value = amx_ctof(*utils::get_amxaddr(amx, params[i + paramOffset + 1]));
-      } else {
-        value = amx_ctof(params[i + 1]);
-      }
-      argv[i] = v8::Number::New(isolate, value);
+      cell value = arg.value;
+      argv[i] = v8::Number::New(isolate, amx_ctof(value));
       break;
     }
     }
@@ -160,12 +168,19 @@ v8::Local<v8::Value> *convertAmxParamsToV8(AMX *amx, cell *params,
 
 bool event::register_event(const std::string &eventName,
                            const std::string &param_types) {
+  std::lock_guard<std::mutex> lock(eventsMutex);
   if (events.find(eventName) != events.end())
     return false;
   events.insert({eventName, new event(eventName, param_types)});
   return true;
 }
 
+event *event::find(const std::string &eventName) {
+  std::lock_guard<std::mutex> lock(eventsMutex);
+  auto iter = events.find(eventName);
+  return iter != events.end() ? iter->second : nullptr;
+}
+
 void event::register_event(const v8::FunctionCallbackInfo<v8::Value> &info) {
   if (info.Length() > 1) {
     auto isolate = info.GetIsolate();
@@ -182,12 +197,7 @@ void event::register_event(const v8::FunctionCallbackInfo<v8::Value> &info) {
     } else {
       std::string eventName = utils::js_to_string(isolate, info[0]);
       std::string paramTypes = utils::js_to_string(isolate, info[1]);
-      if (events.find(eventName) != events.end()) {
-        info.GetReturnValue().Set(false);
-        return;
-      }
-      events.insert({eventName, new event(eventName, paramTypes)});
-      info.GetReturnValue().Set(true);
+      info.GetReturnValue().Set(register_event(eventName, paramTypes));
     }
   }
 }
@@ -282,12 +292,17 @@ cell event::pawn_call_event(AMX *amx, cell *params) {
   amx_StrParam(amx, params[1], eventName_c);
   const std::string eventName(eventName_c);
 
-  const auto &_event = events.find(eventName);
-  if (_event == events.end())
+  event *_event = find(eventName);
+  if (_event == nullptr)
     return 0;
 
   cell retVal = 0;
-  _event->second->call(amx, params + 1, &retVal, true);
+  if (jsThread.IsActive())
+    jsThread.DispatchEvent(_event, amx, params + 1, &retVal, true);
+  else if (nodeImpl.IsLoadingInBackground())
+    nodeImpl.QueueEvent(_event, amx, params + 1, true);
+  else
+    _event->call(amx, params + 1, &retVal, true);
   return retVal;
 }
 
@@ -314,17 +329,31 @@ void event::append(const v8::Local<v8::Context> &context,
   }
 
   functionList.push_back(EventListener_t(isolate, context, function));
+  if (perfstats::enabled)
+    functionList.back().stats = perfstats::listener_counter(isolate, function);
+  listenerCount = functionList.size();
 }
 
 void event::remove(const EventListener_t &eventListener) {
   functionList.erase(
       std::remove(functionList.begin(), functionList.end(), eventListener),
       functionList.end());
+  listenerCount = functionList.size();
 }
 
-void event::remove_all() { functionList.clear(); }
+void event::clear_listeners() {
+  std::lock_guard<std::mutex> lock(eventsMutex);
+  for (auto &entry : events)
+    entry.second->remove_all();
+}
+
+void event::remove_all() {
+  functionList.clear();
+  listenerCount = 0;
+}
 
 void event::call(v8::Local<v8::Value> *args, int argCount) {
+  NodeImpl::jsEntered = true;
   std::vector<EventListener_t> copiedFunctionList = functionList;
 
   for (auto &listener : copiedFunctionList) {
@@ -347,15 +376,8 @@ void event::call(v8::Local<v8::Value> *args, int argCount) {
     v8::Local<v8::Function> function = listener.function.Get(isolate);
     function->Call(ctx, ctx->Global(), argCount, args).ToLocalChecked();
 
-    if (eh.HasCaught()) {
-      v8::String::Utf8Value str(isolate, eh.Exception());
-      v8::String::Utf8Value stack(
-          isolate,
-          eh.StackTrace(listener.context.Get(isolate)).ToLocalChecked());
-
-      L_ERROR << "Event handling function in resource: " << *str << "\nstack:\n"
-              << *stack << "\n";
-    }
+    if (eh.HasCaught())
+      errorlog::report(isolate, ctx, eh, "event " + name);
   }
 
   if (argCount > 0)
@@ -363,7 +385,35 @@ void event::call(v8::Local<v8::Value> *args, int argCount) {
 }
 
 void event::call(AMX *amx, cell *params, cell *retval, bool isFromPawnNative) {
+  if (functionList.empty())
+    return;
+
+  uint64_t start = perfstats::enabled ? perfstats::now_ns() : 0;
+  std::vector<EventArg_t> args;
+  if (!collect_args(amx, params, isFromPawnNative, args)) {
+    L_ERROR << "Failed to convert AMX parameters to V8 values: "
+            << name.c_str();
+    return;
+  }
+
+  if (perfstats::enabled) {
+    if (stats == nullptr)
+      stats = perfstats::event_counter(name);
+    stats->add_extra(perfstats::now_ns() - start);
+  }
+
+  call(args, retval, isFromPawnNative);
+}
+
+void event::call(const std::vector<EventArg_t> &args, cell *retval,
+                 bool isFromPawnNative) {
+  NodeImpl::jsEntered = true;
+  watchdog::Scope watchdogScope(watchdog::Kind::Event, name.c_str());
+  profiler::TimeScope jsTime;
+  trace::Span span(trace::Category::Event, name.c_str());
   std::vector<EventListener_t> copiedFunctionList = functionList;
+  uint64_t conversionNs = 0;
+  uint64_t jsNs = 0;
 
   for (auto &listener : copiedFunctionList) {
     if (std::find(functionList.begin(), functionList.end(), listener) ==
@@ -382,32 +432,34 @@ void event::call(AMX *amx, cell *params, cell *retval, bool isFromPawnNative) {
 
     v8::TryCatch eh(isolate);
 
-    unsigned int argc;
-    int paramOffset;
-    v8::Local<v8::Value> *argv =
-        convertAmxParamsToV8(amx, params, isolate, ctx, paramTypes, argc,
-                             paramOffset, isFromPawnNative);
-    if (argv == nullptr) {
-      L_ERROR << "Failed to convert AMX parameters to V8 values: "
-              << name.c_str();
-      return;
-    }
+    uint64_t start = perfstats::enabled ? perfstats::now_ns() : 0;
+    std::vector<v8::Local<v8::Value>> argv =
+        convertArgsToV8(args, isolate, ctx);
+    uint64_t converted = perfstats::enabled ? perfstats::now_ns() : 0;
 
     v8::Local<v8::Function> function = listener.function.Get(isolate);
-    v8::MaybeLocal<v8::Value> returnValue =
-        function->Call(ctx, ctx->Global(), argc, argv);
-
-    if (argc > 0)
-      delete[] argv;
+    v8::MaybeLocal<v8::Value> returnValue = function->Call(
+        ctx, ctx->Global(), static_cast<int>(argv.size()), argv.data());
+
+    if (perfstats::enabled) {
+      uint64_t elapsed = perfstats::now_ns() - converted;
+      conversionNs += converted - start;
+      jsNs += elapsed;
+      if (listener.stats != nullptr)
+        listener.stats->record(elapsed);
+    }
 
-    if (eh.HasCaught()) {
-      v8::String::Utf8Value str(isolate, eh.Exception());
-      v8::String::Utf8Value stack(
-          isolate,
-          eh.StackTrace(listener.context.Get(isolate)).ToLocalChecked());
+    if (eh.HasTerminated()) {
+      // terminated further up the stack, let it unwind to that event
+      if (!watchdogScope.Terminated())
+        return;
 
-      L_ERROR << "Exception thrown: " << *str << "\nstack:\n"
-              << *stack << (isFromPawnNative ? "\n" : "");
+      isolate->CancelTerminateExecution();
+      L_ERROR << "watchdog: terminated a listener of " << name;
+      if (retval != nullptr)
+        *retval = watchdog::default_retval();
+    } else if (eh.HasCaught()) {
+      errorlog::report(isolate, ctx, eh, "event " + name);
     } else {
       v8::Local<v8::Value> returnValueLocal = returnValue.ToLocalChecked();
       int cppIntReturnValue =
@@ -416,5 +468,11 @@ void event::call(AMX *amx, cell *params, cell *retval, bool isFromPawnNative) {
         *retval = static_cast<cell>(cppIntReturnValue);
     }
   }
+
+  if (perfstats::enabled) {
+    if (stats == nullptr)
+      stats = perfstats::event_counter(name);
+    stats->record(jsNs, conversionNs);
+  }
 }
 } // namespace sampnode
@@ -1,9 +1,14 @@
 #pragma once
+#include <atomic>
 #include <map>
+#include <mutex>
+#include <string>
 #include <unordered_map>
+#include <vector>
 
 #include "amx/amx.h"
 #include "node.h"
+#include "perfstats.hpp"
 #include "uv.h"
 #include "v8.h"
 
@@ -16,11 +21,13 @@ public:
         context;
     v8::Persistent<v8::Function, v8::CopyablePersistentTraits<v8::Function>>
         function;
+    perfstats::Counter_t *stats = nullptr;
 
     EventListener_t(const EventListener_t &listener) {
       isolate = listener.isolate;
       context = listener.context;
       function = listener.function;
+      stats = listener.stats;
     }
 
     EventListener_t(
@@ -55,12 +62,23 @@ public:
     }
   };
 
+  // AMX event argument copied out of AMX memory, so it can outlive the call
+  struct EventArg_t {
+    char type;
+    cell value;
+    std::string string;
+    std::vector<cell> array;
+  };
+
   static void on(const v8::FunctionCallbackInfo<v8::Value> &info);
   static void remove_listener(const v8::FunctionCallbackInfo<v8::Value> &info);
   static void register_event(const v8::FunctionCallbackInfo<v8::Value> &info);
   static bool register_event(const std::string &eventName,
                              const std::string &param_types);
   static cell pawn_call_event(AMX *amx, cell *params);
+  static event *find(const std::string &eventName);
+  // drops the listeners of every event, registrations are kept
+  static void clear_listeners();
 
   event(const std::string &eventName, const std::string &param_types);
   event();
@@ -72,17 +90,28 @@ public:
   void remove_all();
   void call(v8::Local<v8::Value> *args, int argCount);
   void call(AMX *amx, cell *params, cell *retval, bool isFromPawnNative);
+  void call(const std::vector<EventArg_t> &args, cell *retval,
+            bool isFromPawnNative);
+  bool collect_args(AMX *amx, cell *params, bool isFromPawnNative,
+                    std::vector<EventArg_t> &args);
 
   std::string get_param_types() { return paramTypes; }
+  const std::string &get_name() const { return name; }
+  bool has_listeners() const { return listenerCount.load() > 0; }
 
 private:
   std::string name;
   std::string paramTypes;
   std::vector<EventListener_t> functionList;
+  std::atomic<size_t> listenerCount{0};
+  perfstats::Counter_t *stats = nullptr;
   v8::Persistent<v8::Function, v8::CopyablePersistentTraits<v8::Function>>
       listener;
 };
 
 typedef std::unordered_map<std::string, sampnode::event *> eventsContainer;
 extern eventsContainer events;
+// guards inserts into `events` against lookups from the server thread when
+// the JS runtime lives on its own thread
+extern std::mutex eventsMutex;
 } // namespace sampnode
@@ -1,5 +1,6 @@
 #include "functions.hpp"
 
+#include <algorithm>
 #include <string>
 #include <utility>
 
@@ -7,8 +8,16 @@
 #include "common.hpp"
 #include "config.hpp"
 #include "events.hpp"
+#include "heapdiag.hpp"
 #include "natives.hpp"
 #include "nodeimpl.hpp"
+#include "perfstats.hpp"
+#include "playermirror.hpp"
+#include "profiler.hpp"
+#include "spatial.hpp"
+#include "tickstats.hpp"
+#include "trace.hpp"
+#include "worldstate.hpp"
 
 static std::pair<std::string, v8::FunctionCallback>
     sampnodeSpecificFunctions[] = {
@@ -20,20 +29,28 @@ static std::pair<std::string, v8::FunctionCallback>
         {"registerEvent", sampnode::event::register_event},
         {"callNative", sampnode::native::call},
         {"callNativeFloat", sampnode::native::call_float},
+        {"applyBatch", sampnode::native::apply_batch},
         {"callPublic", sampnode::callback::call},
         {"callPublicFloat", sampnode::callback::call_float},
-        {"logprint", sampnode::functions::logprint}};
+        {"logprint", sampnode::functions::logprint},
+        {"getTickStats", sampnode::tickstats::get},
+        {"getAllocatorStats", sampnode::functions::get_allocator_stats},
+        {"getStats", sampnode::perfstats::get},
+        {"snapshotPlayers", sampnode::worldstate::snapshot_players},
+        {"snapshotVehicles", sampnode::worldstate::snapshot_vehicles}};
 
 static void onESMLoaded(const v8::FunctionCallbackInfo<v8::Value> &info) {
-  sampnode::nodeImpl.esmLoading = false;
+  if (info.Length() > 0 && info[0]->IsString()) {
+    v8::String::Utf8Value compileCache(info.GetIsolate(), info[0]);
+    L_INFO << "compile cache: " << *compileCache;
+  }
+  sampnode::nodeImpl.NotifyLoaded();
 }
 
 namespace sampnode {
-void functions::init(v8::Isolate *isolate,
-                     v8::Local<v8::ObjectTemplate> &global) {
-  Props_t &config = nodeImpl.GetMainConfig();
-
-  v8::Locker locker(isolate);
+namespace {
+v8::Local<v8::ObjectTemplate> make_samp_object(v8::Isolate *isolate,
+                                               const Props_t &config) {
   v8::Local<v8::ObjectTemplate> sampObject = v8::ObjectTemplate::New(isolate);
   for (auto &routine : sampnodeSpecificFunctions) {
     sampObject->Set(v8::String::NewFromUtf8(isolate, routine.first.c_str(),
@@ -42,11 +59,62 @@ void functions::init(v8::Isolate *isolate,
                     v8::FunctionTemplate::New(isolate, routine.second));
   }
 
-  global->Set(
-      v8::String::NewFromUtf8(isolate, "samp", v8::NewStringType::kNormal)
-          .ToLocalChecked(),
-      sampObject);
+  v8::Local<v8::ObjectTemplate> profilerObject =
+      v8::ObjectTemplate::New(isolate);
+  profilerObject->Set(
+      v8::String::NewFromUtf8(isolate, "start").ToLocalChecked(),
+      v8::FunctionTemplate::New(isolate, profiler::start));
+  profilerObject->Set(v8::String::NewFromUtf8(isolate, "stop").ToLocalChecked(),
+                      v8::FunctionTemplate::New(isolate, profiler::stop));
+  sampObject->Set(v8::String::NewFromUtf8(isolate, "profiler").ToLocalChecked(),
+                  profilerObject);
+
+  v8::Local<v8::ObjectTemplate> traceObject = v8::ObjectTemplate::New(isolate);
+  traceObject->Set(v8::String::NewFromUtf8(isolate, "start").ToLocalChecked(),
+                   v8::FunctionTemplate::New(isolate, trace::js_start));
+  traceObject->Set(v8::String::NewFromUtf8(isolate, "stop").ToLocalChecked(),
+                   v8::FunctionTemplate::New(isolate, trace::js_stop));
+  sampObject->Set(v8::String::NewFromUtf8(isolate, "trace").ToLocalChecked(),
+                  traceObject);
+
+  v8::Local<v8::ObjectTemplate> heapObject = v8::ObjectTemplate::New(isolate);
+  heapObject->Set(v8::String::NewFromUtf8(isolate, "snapshot").ToLocalChecked(),
+                  v8::FunctionTemplate::New(isolate, heapdiag::snapshot));
+  heapObject->Set(
+      v8::String::NewFromUtf8(isolate, "startSampling").ToLocalChecked(),
+      v8::FunctionTemplate::New(isolate, heapdiag::start_sampling));
+  heapObject->Set(
+      v8::String::NewFromUtf8(isolate, "stopSampling").ToLocalChecked(),
+      v8::FunctionTemplate::New(isolate, heapdiag::stop_sampling));
+  sampObject->Set(v8::String::NewFromUtf8(isolate, "heap").ToLocalChecked(),
+                  heapObject);
+
+  sampObject->Set(
+      v8::String::NewFromUtf8(isolate, "playerFields").ToLocalChecked(),
+      worldstate::player_fields(isolate));
+  sampObject->Set(
+      v8::String::NewFromUtf8(isolate, "vehicleFields").ToLocalChecked(),
+      worldstate::vehicle_fields(isolate));
+
+  sampObject->SetLazyDataProperty(
+      v8::String::NewFromUtf8(isolate, "playerMirror").ToLocalChecked(),
+      playermirror::get);
+  sampObject->Set(
+      v8::String::NewFromUtf8(isolate, "playerMirrorLayout").ToLocalChecked(),
+      playermirror::layout(isolate));
 
+  sampObject->Set(v8::String::NewFromUtf8(isolate, "spatial").ToLocalChecked(),
+                  spatial::make_object(isolate));
+
+  // natives and publics return promises when JS runs on its own thread
+  sampObject->Set(
+      v8::String::NewFromUtf8(isolate, "threaded").ToLocalChecked(),
+      v8::Boolean::New(isolate, config.threaded_runtime));
+  return sampObject;
+}
+
+v8::Local<v8::ObjectTemplate> make_resource_object(v8::Isolate *isolate,
+                                                   const Props_t &config) {
   v8::Local<v8::ObjectTemplate> resourceObj = v8::ObjectTemplate::New(isolate);
 
   resourceObj->Set(
@@ -55,14 +123,52 @@ void functions::init(v8::Isolate *isolate,
       v8::String::NewFromUtf8(isolate, config.entry_file.c_str())
           .ToLocalChecked());
 
+  resourceObj->Set(
+      v8::String::NewFromUtf8(isolate, "compileCacheDir").ToLocalChecked(),
+      v8::String::NewFromUtf8(isolate, config.compile_cache_dir.c_str())
+          .ToLocalChecked());
+  return resourceObj;
+}
+} // namespace
+
+void functions::init(v8::Isolate *isolate,
+                     v8::Local<v8::ObjectTemplate> &global) {
+  Props_t &config = nodeImpl.GetMainConfig();
+
+  v8::Locker locker(isolate);
+  global->Set(
+      v8::String::NewFromUtf8(isolate, "samp", v8::NewStringType::kNormal)
+          .ToLocalChecked(),
+      make_samp_object(isolate, config));
+
   global->Set(
       v8::String::NewFromUtf8(isolate, "__internal_resource").ToLocalChecked(),
-      resourceObj);
+      make_resource_object(isolate, config));
   global->Set(
       v8::String::NewFromUtf8(isolate, "__internal_esmLoaded").ToLocalChecked(),
       v8::FunctionTemplate::New(isolate, &onESMLoaded));
 }
 
+void functions::install(v8::Isolate *isolate, v8::Local<v8::Context> context) {
+  Props_t &config = nodeImpl.GetMainConfig();
+  v8::Local<v8::Object> global = context->Global();
+
+  global
+      ->Set(context, v8::String::NewFromUtf8(isolate, "samp").ToLocalChecked(),
+            make_samp_object(isolate, config)
+                ->NewInstance(context)
+                .ToLocalChecked())
+      .Check();
+  global
+      ->Set(context,
+            v8::String::NewFromUtf8(isolate, "__internal_resource")
+                .ToLocalChecked(),
+            make_resource_object(isolate, config)
+                ->NewInstance(context)
+                .ToLocalChecked())
+      .Check();
+}
+
 void functions::logprint(const v8::FunctionCallbackInfo<v8::Value> &info) {
   if (info.Length() > 0) {
     v8::Isolate *isolate = info.GetIsolate();
@@ -73,14 +179,74 @@ void functions::logprint(const v8::FunctionCallbackInfo<v8::Value> &info) {
     if (!info[0]->IsString())
       return;
 
-    v8::String::Utf8Value _str(isolate, info[0]);
-
     LogLevel level = LogLevel::LOG_INFO;
     if (info.Length() > 1 && info[1]->IsNumber())
       level = static_cast<LogLevel>(
           info[1]->Int32Value(isolate->GetCurrentContext()).ToChecked());
 
+    // skip the utf8 conversion for lines that would be discarded
+    if (!Log::Enabled(level))
+      return;
+
+    v8::String::Utf8Value _str(isolate, info[0]);
     Log().Get(level) << *_str;
   }
 }
-} // namespace sampnode
\ No newline at end of file
+
+void functions::console_write(const v8::FunctionCallbackInfo<v8::Value> &info) {
+  if (info.Length() < 2 || !info[1]->IsString())
+    return;
+
+  v8::Isolate *isolate = info.GetIsolate();
+  LogLevel level = static_cast<LogLevel>(
+      info[0]->Int32Value(isolate->GetCurrentContext()).FromMaybe(3));
+  if (!Log::Enabled(level))
+    return;
+
+  v8::String::Utf8Value text(isolate, info[1]);
+  const char *begin = *text;
+  const char *end = begin + text.length();
+  while (begin < end) {
+    const char *newline = std::find(begin, end, '\n');
+    Log().Get(level) << std::string(begin, newline);
+    begin = newline + 1;
+  }
+}
+
+void functions::get_allocator_stats(
+    const v8::FunctionCallbackInfo<v8::Value> &info) {
+  v8::Isolate *isolate = info.GetIsolate();
+  v8::HandleScope scope(isolate);
+  v8::Local<v8::Context> context = isolate->GetCurrentContext();
+
+  PooledAllocator *allocator = nodeImpl.GetPooledAllocator();
+  if (allocator == nullptr) {
+    info.GetReturnValue().SetNull();
+    return;
+  }
+
+  auto stats = allocator->GetStats();
+  v8::Local<v8::Array> result = v8::Array::New(isolate, stats.size());
+  for (uint32_t i = 0; i < stats.size(); i++) {
+    v8::Local<v8::Object> entry = v8::Object::New(isolate);
+    auto set = [&](const char *key, double value) {
+      entry
+          ->Set(context,
+                v8::String::NewFromUtf8(isolate, key).ToLocalChecked(),
+                v8::Number::New(isolate, value))
+          .Check();
+    };
+
+    set("size", static_cast<double>(stats[i].size));
+    set("allocations", static_cast<double>(stats[i].allocations));
+    set("frees", static_cast<double>(stats[i].frees));
+    set("poolHits", static_cast<double>(stats[i].poolHits));
+    set("bytes", static_cast<double>(stats[i].bytes));
+    set("peakBytes", static_cast<double>(stats[i].peakBytes));
+    set("cachedBytes", static_cast<double>(stats[i].cachedBytes));
+    result->Set(context, i, entry).Check();
+  }
+
+  info.GetReturnValue().Set(result);
+}
+} // namespace sampnode
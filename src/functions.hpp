@@ -7,6 +7,13 @@
 namespace sampnode {
 namespace functions {
 void init(v8::Isolate *isolate, v8::Local<v8::ObjectTemplate> &global);
+// same globals for a context that was deserialized from a snapshot, which
+// can't be created from a template
+void install(v8::Isolate *isolate, v8::Local<v8::Context> context);
 void logprint(const v8::FunctionCallbackInfo<v8::Value> &info);
+// (level, text) from the console routing, one log line per line of text
+void console_write(const v8::FunctionCallbackInfo<v8::Value> &info);
+// per size class counters of the pooled ArrayBuffer allocator, null if off
+void get_allocator_stats(const v8::FunctionCallbackInfo<v8::Value> &info);
 } // namespace functions
 } // namespace sampnode
\ No newline at end of file
@@ -0,0 +1,202 @@
+#include "heapdiag.hpp"
+
+#include <chrono>
+#include <fstream>
+
+#include "tickstats.hpp"
+#include "utils.hpp"
+#include "v8-profiler.h"
+
+namespace sampnode {
+namespace heapdiag {
+namespace {
+constexpr size_t kMB = 1024 * 1024;
+constexpr uint64_t kDefaultSamplingInterval = 512 * 1024;
+constexpr auto kIdleSampleInterval = std::chrono::seconds(1);
+
+bool limitRaised = false;
+bool sampling = false;
+std::chrono::steady_clock::time_point lastSample;
+
+class FileStream : public v8::OutputStream {
+public:
+  explicit FileStream(const std::string &path)
+      : file(path, std::ofstream::out | std::ofstream::trunc) {}
+
+  bool IsOpen() const { return file.is_open(); }
+  bool Good() const { return file.good(); }
+
+  int GetChunkSize() override { return 64 * 1024; }
+  void EndOfStream() override { file.flush(); }
+  WriteResult WriteAsciiChunk(char *data, int size) override {
+    file.write(data, size);
+    return file.good() ? kContinue : kAbort;
+  }
+
+private:
+  std::ofstream file;
+};
+
+size_t on_near_heap_limit(void *data, size_t currentLimit,
+                          size_t initialLimit) {
+  if (limitRaised)
+    return currentLimit;
+  limitRaised = true;
+
+  auto isolate = static_cast<v8::Isolate *>(data);
+  L_ERROR << "JS heap is close to its limit of " << currentLimit / kMB
+          << " MB, writing a heap snapshot";
+
+  std::string path = utils::timestamped_file(".heapsnapshot");
+  if (write_snapshot(isolate, path))
+    L_ERROR << "heap snapshot written to " << path;
+
+  size_t raisedLimit = currentLimit + currentLimit / 2;
+  L_ERROR << "heap limit raised once to " << raisedLimit / kMB
+          << " MB, the server will stop when that is exhausted too";
+  return raisedLimit;
+}
+
+std::string js_path(const v8::FunctionCallbackInfo<v8::Value> &info,
+                    const char *extension) {
+  if (info.Length() > 0 && info[0]->IsString())
+    return utils::js_to_string(info.GetIsolate(), info[0]);
+  return utils::timestamped_file(extension);
+}
+
+json profile_node(v8::Isolate *isolate,
+                  const v8::AllocationProfile::Node *node) {
+  size_t selfSize = 0;
+  for (auto &allocation : node->allocations)
+    selfSize += allocation.size * allocation.count;
+
+  json children = json::array();
+  for (auto *child : node->children)
+    children.push_back(profile_node(isolate, child));
+
+  // DevTools expects zero-based positions
+  return {{"callFrame",
+           {{"functionName", utils::js_to_string(isolate, node->name)},
+            {"scriptId", std::to_string(node->script_id)},
+            {"url", utils::js_to_string(isolate, node->script_name)},
+            {"lineNumber", node->line_number - 1},
+            {"columnNumber", node->column_number - 1}}},
+          {"selfSize", selfSize},
+          {"id", node->node_id},
+          {"children", children}};
+}
+} // namespace
+
+void install(v8::Isolate *isolate, const Props_t &config) {
+  limitRaised = false;
+  if (config.heap_limit_snapshot)
+    isolate->AddNearHeapLimitCallback(on_near_heap_limit, isolate);
+}
+
+void uninstall(v8::Isolate *isolate) {
+  v8::Locker locker(isolate);
+  v8::Isolate::Scope isolateScope(isolate);
+
+  isolate->RemoveNearHeapLimitCallback(on_near_heap_limit, 0);
+  if (sampling) {
+    isolate->GetHeapProfiler()->StopSamplingHeapProfiler();
+    sampling = false;
+  }
+}
+
+void on_tick(v8::Isolate *isolate, bool idle) {
+  auto now = std::chrono::steady_clock::now();
+  if (idle && now - lastSample < kIdleSampleInterval)
+    return;
+  lastSample = now;
+
+  v8::Locker locker(isolate);
+  v8::HeapStatistics heap;
+  isolate->GetHeapStatistics(&heap);
+  tickstats::record_heap(heap.used_heap_size(), heap.heap_size_limit(),
+                         heap.external_memory());
+}
+
+bool write_snapshot(v8::Isolate *isolate, const std::string &path) {
+  FileStream stream(path);
+  if (!stream.IsOpen()) {
+    L_ERROR << "Unable to write heap snapshot " << path;
+    return false;
+  }
+
+  v8::HandleScope scope(isolate);
+  const v8::HeapSnapshot *snapshot =
+      isolate->GetHeapProfiler()->TakeHeapSnapshot();
+  snapshot->Serialize(&stream, v8::HeapSnapshot::kJSON);
+  const_cast<v8::HeapSnapshot *>(snapshot)->Delete();
+  return stream.Good();
+}
+
+void snapshot(const v8::FunctionCallbackInfo<v8::Value> &info) {
+  v8::Isolate *isolate = info.GetIsolate();
+  v8::HandleScope scope(isolate);
+
+  std::string path = js_path(info, ".heapsnapshot");
+  if (!write_snapshot(isolate, path)) {
+    info.GetReturnValue().SetNull();
+    return;
+  }
+
+  info.GetReturnValue().Set(
+      v8::String::NewFromUtf8(isolate, path.c_str()).ToLocalChecked());
+}
+
+void start_sampling(const v8::FunctionCallbackInfo<v8::Value> &info) {
+  v8::Isolate *isolate = info.GetIsolate();
+
+  uint64_t interval = kDefaultSamplingInterval;
+  if (info.Length() > 0 && info[0]->IsNumber()) {
+    double value =
+        info[0]->NumberValue(isolate->GetCurrentContext()).FromMaybe(0);
+    if (value >= 1)
+      interval = static_cast<uint64_t>(value);
+  }
+
+  sampling = !sampling &&
+             isolate->GetHeapProfiler()->StartSamplingHeapProfiler(interval);
+  info.GetReturnValue().Set(sampling);
+}
+
+void stop_sampling(const v8::FunctionCallbackInfo<v8::Value> &info) {
+  v8::Isolate *isolate = info.GetIsolate();
+  v8::HandleScope scope(isolate);
+
+  if (!sampling) {
+    info.GetReturnValue().SetNull();
+    return;
+  }
+
+  v8::HeapProfiler *profiler = isolate->GetHeapProfiler();
+  std::unique_ptr<v8::AllocationProfile> profile(
+      profiler->GetAllocationProfile());
+  profiler->StopSamplingHeapProfiler();
+  sampling = false;
+
+  std::string path = js_path(info, ".heapprofile");
+  std::ofstream file(path, std::ofstream::out | std::ofstream::trunc);
+  if (!profile || !file.is_open()) {
+    L_ERROR << "Unable to write heap profile " << path;
+    info.GetReturnValue().SetNull();
+    return;
+  }
+
+  json samples = json::array();
+  for (auto &sample : profile->GetSamples())
+    samples.push_back({{"size", sample.size * sample.count},
+                       {"nodeId", sample.node_id},
+                       {"ordinal", sample.sample_id}});
+
+  file << json{{"head", profile_node(isolate, profile->GetRootNode())},
+               {"samples", samples}}
+              .dump();
+
+  info.GetReturnValue().Set(
+      v8::String::NewFromUtf8(isolate, path.c_str()).ToLocalChecked());
+}
+} // namespace heapdiag
+} // namespace sampnode
@@ -0,0 +1,28 @@
+#pragma once
+#include <string>
+
+#include "config.hpp"
+#include "node.h"
+#include "v8.h"
+
+namespace sampnode {
+namespace heapdiag {
+// With heap_limit_snapshot, a heap about to run out writes a snapshot and
+// gets its limit raised once, so the snapshot can be taken and the server
+// keeps running long enough for someone to notice.
+void install(v8::Isolate *isolate, const Props_t &config);
+void uninstall(v8::Isolate *isolate);
+
+// heap size into the tick stats, after every tick that ran JS and about once
+// a second while idle, which keeps the Locker off most idle ticks
+void on_tick(v8::Isolate *isolate, bool idle);
+
+bool write_snapshot(v8::Isolate *isolate, const std::string &path);
+
+// samp.heap.snapshot([path]), samp.heap.startSampling([intervalBytes]) and
+// samp.heap.stopSampling([path])
+void snapshot(const v8::FunctionCallbackInfo<v8::Value> &info);
+void start_sampling(const v8::FunctionCallbackInfo<v8::Value> &info);
+void stop_sampling(const v8::FunctionCallbackInfo<v8::Value> &info);
+} // namespace heapdiag
+} // namespace sampnode
@@ -0,0 +1,85 @@
+#include "hibernation.hpp"
+
+#include <chrono>
+#include <cstring>
+#include <unordered_set>
+#include <vector>
+
+namespace sampnode {
+namespace hibernation {
+namespace {
+using Clock = std::chrono::steady_clock;
+
+bool enabled = false;
+std::chrono::milliseconds delay{0};
+std::chrono::milliseconds tickInterval{0};
+
+// filterscripts get their own OnPlayerConnect, so count ids and not calls
+std::unordered_set<cell> players;
+bool hibernating = false;
+Clock::time_point emptySince = Clock::now();
+Clock::time_point lastTick;
+
+std::vector<std::function<void()>> trimHooks;
+} // namespace
+
+void init(const Props_t &config) {
+  enabled = config.hibernate;
+  delay = std::chrono::milliseconds(config.hibernate_delay_ms);
+  tickInterval = std::chrono::milliseconds(config.hibernate_tick_ms);
+  emptySince = Clock::now();
+}
+
+void on_public_call(AMX *amx, const char *name, cell *params) {
+  if (!enabled || std::strncmp(name, "OnPlayer", 8) != 0)
+    return;
+
+  if (std::strcmp(name, "OnPlayerConnect") == 0) {
+    players.insert(params[1]);
+  } else if (std::strcmp(name, "OnPlayerDisconnect") == 0) {
+    players.erase(params[1]);
+    if (players.empty())
+      emptySince = Clock::now();
+  }
+}
+
+Transition update() {
+  if (!enabled)
+    return Transition::None;
+
+  if (hibernating && !players.empty()) {
+    hibernating = false;
+    return Transition::Leave;
+  }
+
+  if (!hibernating && players.empty() && Clock::now() - emptySince >= delay) {
+    hibernating = true;
+    lastTick = Clock::now();
+    return Transition::Enter;
+  }
+  return Transition::None;
+}
+
+bool skip_tick() {
+  if (!hibernating)
+    return false;
+
+  Clock::time_point now = Clock::now();
+  if (now - lastTick < tickInterval)
+    return true;
+  lastTick = now;
+  return false;
+}
+
+bool is_hibernating() { return hibernating; }
+
+void add_trim_hook(std::function<void()> hook) {
+  trimHooks.push_back(std::move(hook));
+}
+
+void run_trim_hooks() {
+  for (auto &hook : trimHooks)
+    hook();
+}
+} // namespace hibernation
+} // namespace sampnode
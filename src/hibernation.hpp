@@ -0,0 +1,27 @@
+#pragma once
+#include <functional>
+
+#include "amx/amx.h"
+#include "config.hpp"
+
+namespace sampnode {
+namespace hibernation {
+enum class Transition { None, Enter, Leave };
+
+void init(const Props_t &config);
+
+// server thread, keeps track of connected players
+void on_public_call(AMX *amx, const char *name, cell *params);
+
+// server thread, once per ProcessTick
+Transition update();
+// true while hibernating and the reduced tick interval hasn't passed yet
+bool skip_tick();
+bool is_hibernating();
+
+// Pools register here to give their cached memory back on hibernation. The
+// hooks run on the thread that owns the isolate.
+void add_trim_hook(std::function<void()> hook);
+void run_trim_hooks();
+} // namespace hibernation
+} // namespace sampnode
@@ -0,0 +1,137 @@
+#include "idlegc.hpp"
+
+#include <algorithm>
+#include <chrono>
+
+#include "tickstats.hpp"
+#include "trace.hpp"
+
+namespace sampnode {
+namespace idlegc {
+namespace {
+// not worth taking the Locker for
+constexpr uint64_t kMinSlackNs = 500000;
+
+v8::Platform *gcPlatform = nullptr;
+uint64_t budgetNs = 0;
+
+uint64_t pauseStartNs = 0;
+
+// heap left over by the last full GC, growth beyond this makes us start
+// incremental marking early, in a quiet tick, instead of V8 forcing it later
+size_t heapAfterMajorGc = 0;
+bool pressureRaised = false;
+bool majorGcFinished = false;
+
+// V8 asks not to be notified again until real work has been done
+bool idleWorkDone = false;
+// pauses inside our own notifications are spent from the idle budget
+bool inIdleTime = false;
+
+uint64_t now_ns() {
+  return std::chrono::duration_cast<std::chrono::nanoseconds>(
+             std::chrono::steady_clock::now().time_since_epoch())
+      .count();
+}
+
+const char *gc_name(v8::GCType type) {
+  if (type & v8::kGCTypeMarkSweepCompact)
+    return "MarkSweepCompact";
+  if (type & v8::kGCTypeScavenge)
+    return "Scavenge";
+  if (type & v8::kGCTypeMinorMarkSweep)
+    return "MinorMarkSweep";
+  if (type & v8::kGCTypeIncrementalMarking)
+    return "IncrementalMarking";
+  return "ProcessWeakCallbacks";
+}
+
+void on_prologue(v8::Isolate *isolate, v8::GCType type,
+                 v8::GCCallbackFlags flags, void *data) {
+  pauseStartNs = now_ns();
+}
+
+void on_epilogue(v8::Isolate *isolate, v8::GCType type,
+                 v8::GCCallbackFlags flags, void *data) {
+  bool major = (type & v8::kGCTypeMarkSweepCompact) != 0;
+  uint64_t endNs = now_ns();
+  tickstats::record_gc(endNs - pauseStartNs, major, inIdleTime);
+
+  if (trace::enabled.load(std::memory_order_relaxed))
+    trace::record(trace::Category::Gc, gc_name(type), pauseStartNs, endNs);
+
+  if (major) {
+    v8::HeapStatistics heap;
+    isolate->GetHeapStatistics(&heap);
+    heapAfterMajorGc = heap.used_heap_size();
+    majorGcFinished = true;
+  }
+}
+} // namespace
+
+void install(v8::Isolate *isolate, v8::Platform *platform,
+             const Props_t &config) {
+  gcPlatform = platform;
+  budgetNs = static_cast<uint64_t>(config.idle_gc_budget_ms) * 1000000;
+  tickstats::overrunThresholdNs =
+      static_cast<uint64_t>(config.tick_overrun_ms) * 1000000;
+
+  isolate->AddGCPrologueCallback(on_prologue);
+  isolate->AddGCEpilogueCallback(on_epilogue);
+}
+
+void uninstall(v8::Isolate *isolate) {
+  isolate->RemoveGCPrologueCallback(on_prologue);
+  isolate->RemoveGCEpilogueCallback(on_epilogue);
+  gcPlatform = nullptr;
+}
+
+void on_tick(v8::Isolate *isolate, bool idle) {
+  if (!idle)
+    idleWorkDone = false;
+
+  if (budgetNs == 0 || gcPlatform == nullptr || idleWorkDone)
+    return;
+
+  uint64_t slackNs = std::min(tickstats::slack_ns(), budgetNs);
+  if (slackNs < kMinSlackNs)
+    return;
+
+  uint64_t start = now_ns();
+  v8::Locker locker(isolate);
+  v8::Isolate::Scope isolateScope(isolate);
+  v8::HandleScope handleScope(isolate);
+  inIdleTime = true;
+
+  if (majorGcFinished) {
+    majorGcFinished = false;
+    if (pressureRaised) {
+      isolate->MemoryPressureNotification(v8::MemoryPressureLevel::kNone);
+      pressureRaised = false;
+    }
+  }
+
+  if (!pressureRaised && heapAfterMajorGc != 0) {
+    v8::HeapStatistics heap;
+    isolate->GetHeapStatistics(&heap);
+    if (heap.used_heap_size() > heapAfterMajorGc + heapAfterMajorGc / 2) {
+      isolate->MemoryPressureNotification(v8::MemoryPressureLevel::kModerate);
+      pressureRaised = true;
+    }
+  }
+
+  // the checks above took a little of the slack already
+  uint64_t spentNs = now_ns() - start;
+  if (spentNs >= slackNs) {
+    inIdleTime = false;
+    return;
+  }
+  double deadline = gcPlatform->MonotonicallyIncreasingTime() +
+                    (slackNs - spentNs) / 1e9;
+  idleWorkDone = isolate->IdleNotificationDeadline(deadline);
+  inIdleTime = false;
+
+  tickstats::record_idle_gc(now_ns() - start);
+}
+} // namespace idlegc
+} // namespace sampnode
@@ -0,0 +1,20 @@
+#pragma once
+#include <cstdint>
+
+#include "config.hpp"
+#include "node.h"
+#include "v8.h"
+
+namespace sampnode {
+namespace idlegc {
+// Records every GC pause into the tick stats and, with idle_gc_budget_ms
+// set, hands the unused part of that budget to V8 at the end of each tick.
+void install(v8::Isolate *isolate, v8::Platform *platform,
+             const Props_t &config);
+void uninstall(v8::Isolate *isolate);
+
+// ProcessTick, after the server tick's own NodeImpl::Tick. Hands V8 what is
+// left until the next server tick, at most idle_gc_budget_ms of it.
+void on_tick(v8::Isolate *isolate, bool idle);
+} // namespace idlegc
+} // namespace sampnode
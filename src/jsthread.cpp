@@ -0,0 +1,302 @@
+#include "jsthread.hpp"
+
+#include <chrono>
+
+#include "logger.hpp"
+#include "nodeimpl.hpp"
+#include "profiler.hpp"
+#include "trace.hpp"
+#include "workers.hpp"
+
+namespace sampnode {
+JsThread jsThread;
+
+namespace {
+constexpr size_t kQueueCapacity = 16384;
+} // namespace
+
+JsThread::JsThread()
+    : eventQueue(kQueueCapacity), mainQueue(kQueueCapacity),
+      completedQueue(kQueueCapacity) {}
+
+JsThread::~JsThread() {}
+
+bool JsThread::Start(const Props_t &config) {
+  this->config = config;
+  asyncEvents = std::unordered_set<std::string>(config.async_events.begin(),
+                                                config.async_events.end());
+  running = true;
+  active = true;
+  thread = std::thread(&JsThread::Run, this);
+
+  // events are queued and natives served from ProcessTick until it is ready
+  if (config.background_init) {
+    L_INFO << "loading the JS runtime in the background";
+    return true;
+  }
+
+  // the entry file may already await natives while it is being imported
+  std::unique_lock<std::mutex> lock(mainMutex);
+  while (!ready) {
+    lock.unlock();
+    ProcessMainQueue();
+    workers::process_queue();
+    lock.lock();
+
+    mainWaiting = true;
+    if (!ready && mainQueue.empty())
+      mainCv.wait_for(lock, std::chrono::milliseconds(1));
+    mainWaiting = false;
+  }
+
+  L_INFO << "JS runtime is running on a dedicated thread";
+  return true;
+}
+
+void JsThread::Stop() {
+  if (!active)
+    return;
+
+  running = false;
+  Wake();
+  thread.join();
+  active = false;
+
+  EventTask_t *event;
+  while (eventQueue.pop(event))
+    delete event;
+
+  Deferred_t *task;
+  while (mainQueue.pop(task))
+    delete task;
+  while (completedQueue.pop(task))
+    delete task;
+}
+
+void JsThread::Run() {
+  trace::set_thread_name("js");
+  nodeImpl.Initialize(config);
+
+  uv_loop_t *loop = nodeImpl.GetUVLoop()->GetLoop();
+  uv_async_init(loop, &wakeup, OnWakeup);
+  wakeup.data = this;
+  wakeupReady = true;
+
+  nodeImpl.LoadResource();
+
+  {
+    std::lock_guard<std::mutex> lock(mainMutex);
+    ready = true;
+  }
+  mainCv.notify_all();
+
+  // events and requests that came in before the handle existed
+  uv_async_send(&wakeup);
+
+  while (running) {
+    nodeImpl.Tick(UV_RUN_ONCE);
+    DrainEvents();
+    profiler::on_tick(nodeImpl.GetIsolate());
+
+    if (nodeImpl.TakeReloadRequest()) {
+      {
+        v8::Locker locker(nodeImpl.GetIsolate());
+        pending.clear();
+      }
+      nodeImpl.ReloadResource();
+    }
+
+    int hibernate = hibernateRequest.exchange(-1);
+    if (hibernate >= 0)
+      nodeImpl.SetHibernating(hibernate == 1);
+  }
+
+  {
+    v8::Locker locker(nodeImpl.GetIsolate());
+    pending.clear();
+  }
+
+  uv_close(reinterpret_cast<uv_handle_t *>(&wakeup), nullptr);
+  uv_run(loop, UV_RUN_NOWAIT);
+
+  nodeImpl.Stop();
+}
+
+void JsThread::DispatchEvent(event *_event, AMX *amx, cell *params,
+                             cell *retval, bool isFromPawnNative) {
+  // while loading, listeners may still be added before the event is drained
+  if (ready && !_event->has_listeners())
+    return;
+
+  auto task = std::make_unique<EventTask_t>();
+  task->target = _event;
+  task->isFromPawnNative = isFromPawnNative;
+
+  if (!_event->collect_args(amx, params, isFromPawnNative, task->args)) {
+    L_ERROR << "Failed to convert AMX parameters to V8 values: "
+            << _event->get_name();
+    return;
+  }
+
+  // nothing could answer while the entry file is still being imported
+  std::shared_ptr<SyncResult_t> result;
+  if (retval != nullptr && ready &&
+      asyncEvents.count(_event->get_name()) == 0) {
+    result = std::make_shared<SyncResult_t>();
+    result->value = *retval;
+    task->result = result;
+  }
+
+  while (!eventQueue.push(task.get())) {
+    Wake();
+    std::this_thread::yield();
+  }
+  task.release();
+  Wake();
+
+  if (!result)
+    return;
+
+  // keep serving natives while waiting, the handler may be awaiting them
+  auto deadline = std::chrono::steady_clock::now() +
+                  std::chrono::milliseconds(config.sync_event_timeout);
+  while (!result->done) {
+    ProcessMainQueue();
+    workers::process_queue();
+    if (result->done)
+      break;
+
+    if (std::chrono::steady_clock::now() >= deadline) {
+      L_WARN << "event " << _event->get_name() << " did not return within "
+             << config.sync_event_timeout
+             << "ms, using the default return value";
+      return;
+    }
+
+    std::unique_lock<std::mutex> lock(mainMutex);
+    mainWaiting = true;
+    if (!result->done && mainQueue.empty())
+      mainCv.wait_for(lock, std::chrono::milliseconds(1));
+    mainWaiting = false;
+  }
+
+  *retval = result->value;
+}
+
+void JsThread::RequestReload() {
+  nodeImpl.RequestReload();
+  Wake();
+}
+
+void JsThread::SetHibernating(bool hibernating) {
+  hibernateRequest = hibernating ? 1 : 0;
+  Wake();
+}
+
+void JsThread::ProcessMainQueue() {
+  Deferred_t *task;
+  bool completed = false;
+
+  while (mainQueue.pop(task)) {
+    task->Invoke();
+    while (!completedQueue.push(task)) {
+      Wake();
+      std::this_thread::yield();
+    }
+    completed = true;
+  }
+
+  if (completed)
+    Wake();
+}
+
+void JsThread::CallNative(const v8::FunctionCallbackInfo<v8::Value> &info,
+                          bool asFloat) {
+  Defer(info, deferred::native(info, asFloat));
+}
+
+void JsThread::CallPublic(const v8::FunctionCallbackInfo<v8::Value> &info,
+                          bool asFloat) {
+  Defer(info, deferred::public_call(info, asFloat));
+}
+
+void JsThread::Defer(const v8::FunctionCallbackInfo<v8::Value> &info,
+                     std::unique_ptr<Deferred_t> task) {
+  v8::Isolate *isolate = info.GetIsolate();
+  v8::Local<v8::Context> context = isolate->GetCurrentContext();
+
+  v8::Local<v8::Promise::Resolver> resolver =
+      v8::Promise::Resolver::New(context).ToLocalChecked();
+  info.GetReturnValue().Set(resolver->GetPromise());
+
+  // arguments were invalid, settle right away like the sync call would
+  if (!task) {
+    resolver->Resolve(context, v8::Undefined(isolate)).Check();
+    return;
+  }
+
+  task->id = ++nextId;
+  pending.emplace(task->id,
+                  v8::Global<v8::Promise::Resolver>(isolate, resolver));
+
+  Deferred_t *raw = task.release();
+  while (!mainQueue.push(raw))
+    std::this_thread::yield();
+  NotifyMain();
+}
+
+void JsThread::DrainEvents() {
+  EventTask_t *raw;
+  while (eventQueue.pop(raw)) {
+    std::unique_ptr<EventTask_t> task(raw);
+
+    if (task->result) {
+      cell value = task->result->value;
+      task->target->call(task->args, &value, task->isFromPawnNative);
+      task->result->value = value;
+      task->result->done = true;
+      NotifyMain();
+    } else {
+      task->target->call(task->args, nullptr, task->isFromPawnNative);
+    }
+  }
+}
+
+void JsThread::ResolveCompleted() {
+  v8::Isolate *isolate = nodeImpl.GetIsolate();
+  v8::HandleScope scope(isolate);
+
+  Deferred_t *raw;
+  while (completedQueue.pop(raw)) {
+    std::unique_ptr<Deferred_t> task(raw);
+
+    auto iter = pending.find(task->id);
+    if (iter == pending.end())
+      continue;
+
+    v8::Local<v8::Promise::Resolver> resolver = iter->second.Get(isolate);
+    pending.erase(iter);
+
+    v8::Local<v8::Context> context = resolver->GetCreationContextChecked();
+    v8::Context::Scope contextScope(context);
+    resolver->Resolve(context, task->Result(isolate, context)).FromMaybe(false);
+  }
+}
+
+void JsThread::Wake() {
+  // until the JS thread has set the handle up, Run picks the work up itself
+  if (wakeupReady)
+    uv_async_send(&wakeup);
+}
+
+void JsThread::NotifyMain() {
+  if (mainWaiting) {
+    std::lock_guard<std::mutex> lock(mainMutex);
+    mainCv.notify_one();
+  }
+}
+
+void JsThread::OnWakeup(uv_async_t *handle) {
+  static_cast<JsThread *>(handle->data)->ResolveCompleted();
+}
+} // namespace sampnode
@@ -0,0 +1,100 @@
+#pragma once
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <unordered_map>
+#include <unordered_set>
+#include <vector>
+
+#include "amx/amx.h"
+#include "config.hpp"
+#include "deferred.hpp"
+#include "events.hpp"
+#include "node.h"
+#include "spscqueue.hpp"
+#include "uv.h"
+#include "v8.h"
+
+namespace sampnode {
+// Runs the isolate, the node environment and its uv loop on a dedicated
+// thread. Events are handed over from the server thread, natives and publics
+// called from JS are handed back and executed in ProcessTick.
+class JsThread {
+public:
+  struct SyncResult_t {
+    std::atomic<bool> done{false};
+    cell value = 0;
+  };
+
+  struct EventTask_t {
+    event *target = nullptr;
+    std::vector<event::EventArg_t> args;
+    bool isFromPawnNative = false;
+    std::shared_ptr<SyncResult_t> result;
+  };
+
+  JsThread();
+  ~JsThread();
+
+  bool Start(const Props_t &config);
+  void Stop();
+  bool IsActive() const noexcept { return active; }
+
+  // server thread
+  void DispatchEvent(event *_event, AMX *amx, cell *params, cell *retval,
+                     bool isFromPawnNative);
+  void ProcessMainQueue();
+  void RequestReload();
+  void SetHibernating(bool hibernating);
+
+  // JS thread
+  void CallNative(const v8::FunctionCallbackInfo<v8::Value> &info,
+                  bool asFloat);
+  void CallPublic(const v8::FunctionCallbackInfo<v8::Value> &info,
+                  bool asFloat);
+  // returns a promise for any other work that has to run on the server thread
+  void Defer(const v8::FunctionCallbackInfo<v8::Value> &info,
+             std::unique_ptr<Deferred_t> task);
+
+private:
+  void Run();
+  void DrainEvents();
+  void ResolveCompleted();
+  void Wake();
+  void NotifyMain();
+
+  static void OnWakeup(uv_async_t *handle);
+
+  std::thread thread;
+  std::atomic<bool> running{false};
+  bool active = false;
+  std::atomic<bool> ready{false};
+
+  Props_t config;
+  std::unordered_set<std::string> asyncEvents;
+
+  uv_async_t wakeup;
+  // set once wakeup was initialized on the JS thread
+  std::atomic<bool> wakeupReady{false};
+  // -1 nothing to do, otherwise the hibernation state to apply
+  std::atomic<int> hibernateRequest{-1};
+
+  SpscQueue<EventTask_t *> eventQueue;
+  SpscQueue<Deferred_t *> mainQueue;
+  SpscQueue<Deferred_t *> completedQueue;
+
+  // only touched on the JS thread
+  uint64_t nextId = 0;
+  std::unordered_map<uint64_t, v8::Global<v8::Promise::Resolver>> pending;
+
+  std::mutex mainMutex;
+  std::condition_variable mainCv;
+  std::atomic<bool> mainWaiting{false};
+};
+
+extern JsThread jsThread;
+} // namespace sampnode
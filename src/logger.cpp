@@ -1,33 +1,218 @@
 #include "logger.hpp"
 
+#include <atomic>
 #include <chrono>
-#include <fstream>
+#include <condition_variable>
+#include <cstdio>
+#include <ctime>
 #include <iomanip>
-#include <iostream>
+#include <memory>
+#include <mutex>
+#include <thread>
 
 #include "config.hpp"
+#include "mpscqueue.hpp"
 
 LogLevel Log::logLevel = LogLevel::LOG_FULL;
 std::string Log::timeFormat = "%Y-%m-%dT%H:%M:%S%z";
 
-void Log::Init(LogLevel level, const std::string &timeFormat) {
+namespace {
+constexpr auto kWriterIdle = std::chrono::milliseconds(10);
+constexpr auto kFlushTimeout = std::chrono::seconds(1);
+constexpr auto kDropReport = std::chrono::seconds(1);
+
+// formatting the time is the expensive part of a line, and it only changes
+// once a second
+const std::string &timestamp() {
+  thread_local std::time_t cachedTime = -1;
+  thread_local std::string cachedStamp;
+
+  auto time =
+      std::chrono::system_clock::to_time_t(std::chrono::system_clock::now());
+  if (time != cachedTime) {
+    std::tm tm;
+#ifdef _WIN32
+    localtime_s(&tm, &time);
+#else
+    localtime_r(&time, &tm);
+#endif
+    std::ostringstream stamp;
+    stamp << "[" << std::put_time(&tm, Log::timeFormat.c_str()) << "]";
+    cachedStamp = stamp.str();
+    cachedTime = time;
+  }
+  return cachedStamp;
+}
+
+// Lines are queued by any thread and written by a single writer thread into
+// a file that stays open, so a burst of errors costs the server thread a
+// queue push instead of a file open and two unbuffered writes.
+class Writer {
+public:
+  ~Writer() { Stop(); }
+
+  void Start(size_t capacity) {
+    if (running)
+      return;
+
+    file = std::fopen("samp-node.log", "a");
+    queue.reset(new sampnode::MpscQueue<std::string *>(capacity));
+    running = true;
+    thread = std::thread(&Writer::Run, this);
+  }
+
+  void Stop() {
+    if (!running.exchange(false))
+      return;
+
+    cv.notify_one();
+    thread.join();
+    Drain();
+
+    std::lock_guard<std::mutex> lock(fileMutex);
+    if (file != nullptr)
+      std::fclose(file);
+    file = nullptr;
+  }
+
+  // takes ownership of the line
+  void Write(std::string *line) {
+    if (!running) {
+      WriteNow(line);
+      return;
+    }
+
+    if (!queue->push(line)) {
+      dropped++;
+      delete line;
+      return;
+    }
+    queued++;
+
+    if (sleeping)
+      cv.notify_one();
+  }
+
+  void Flush() {
+    if (!running)
+      return;
+
+    uint64_t target = queued;
+    auto deadline = std::chrono::steady_clock::now() + kFlushTimeout;
+    while (written < target && std::chrono::steady_clock::now() < deadline) {
+      cv.notify_one();
+      std::this_thread::sleep_for(std::chrono::milliseconds(1));
+    }
+  }
+
+  uint64_t Dropped() const { return dropped; }
+
+private:
+  void Run() {
+    while (running) {
+      if (Drain())
+        continue;
+
+      std::unique_lock<std::mutex> lock(wakeMutex);
+      sleeping = true;
+      cv.wait_for(lock, kWriterIdle);
+      sleeping = false;
+    }
+  }
+
+  // writer thread, or the caller of Stop once the writer has exited
+  bool Drain() {
+    std::lock_guard<std::mutex> lock(fileMutex);
+
+    size_t count = 0;
+    std::string *line;
+    while (queue->pop(line)) {
+      Output(*line);
+      delete line;
+      count++;
+    }
+
+    uint64_t droppedNow = dropped;
+    auto now = std::chrono::steady_clock::now();
+    if (droppedNow != reportedDropped && now - lastDropReport >= kDropReport) {
+      Output(timestamp() + " [Warning] " +
+             std::to_string(droppedNow - reportedDropped) +
+             " log lines dropped, the log queue was full\n");
+      reportedDropped = droppedNow;
+      lastDropReport = now;
+      count++;
+    }
+
+    if (count > 0) {
+      if (file != nullptr)
+        std::fflush(file);
+      std::fflush(stdout);
+      written += count;
+    }
+    return count > 0;
+  }
+
+  void WriteNow(std::string *line) {
+    std::unique_ptr<std::string> owned(line);
+    std::lock_guard<std::mutex> lock(fileMutex);
+
+    std::FILE *out = std::fopen("samp-node.log", "a");
+    if (out != nullptr) {
+      std::fwrite(line->data(), 1, line->size(), out);
+      std::fclose(out);
+    }
+    std::fwrite(line->data(), 1, line->size(), stdout);
+    std::fflush(stdout);
+  }
+
+  void Output(const std::string &line) {
+    if (file != nullptr)
+      std::fwrite(line.data(), 1, line.size(), file);
+    std::fwrite(line.data(), 1, line.size(), stdout);
+  }
+
+  std::unique_ptr<sampnode::MpscQueue<std::string *>> queue;
+  std::thread thread;
+  std::atomic<bool> running{false};
+
+  std::mutex wakeMutex;
+  std::condition_variable cv;
+  std::atomic<bool> sleeping{false};
+
+  std::mutex fileMutex;
+  std::FILE *file = nullptr;
+
+  std::atomic<uint64_t> queued{0};
+  std::atomic<uint64_t> written{0};
+  std::atomic<uint64_t> dropped{0};
+  uint64_t reportedDropped = 0;
+  std::chrono::steady_clock::time_point lastDropReport;
+};
+
+Writer writer;
+} // namespace
+
+void Log::Init(LogLevel level, const std::string &timeFormat,
+               size_t queueSize) {
   logLevel = level;
 
   if (!timeFormat.empty())
     Log::timeFormat = timeFormat;
 
+  writer.Start(queueSize > 0 ? queueSize : 8192);
   L_INFO << "[PLUGIN] samp-node plugin started...";
 }
 
+void Log::Shutdown() { writer.Stop(); }
+
+void Log::Flush() { writer.Flush(); }
+
+uint64_t Log::DroppedLines() { return writer.Dropped(); }
+
 std::ostringstream &Log::Get(LogLevel level) {
   currentLevel = level;
-  if (logLevel > level) {
-    auto now = std::chrono::system_clock::now();
-    auto time = std::chrono::system_clock::to_time_t(now);
-    auto tm = *std::localtime(&time);
-
-    os << "[" << std::put_time(&tm, timeFormat.c_str()) << "]";
-    os << " " << GetLevelName(level) << " ";
+  if (Enabled(level)) {
+    os << timestamp() << " " << GetLevelName(level) << " ";
     return os;
   } else {
     os.str("");
@@ -38,21 +223,13 @@ std::ostringstream &Log::Get(LogLevel level) {
 Log::Log() {}
 
 Log::~Log() {
-  if (logLevel > currentLevel) {
-    os << std::endl;
-
-    std::ofstream file("samp-node.log",
-                       std::ofstream::out | std::ofstream::app);
-    if (file.is_open()) {
-      file << os.str();
-      std::cout << os.str();
-      os.str("");
-      os.clear();
-    }
+  if (Enabled(currentLevel)) {
+    os << '\n';
+    writer.Write(new std::string(os.str()));
   }
 }
 
-std::string Log::GetLevelName(LogLevel level) {
+const char *Log::GetLevelName(LogLevel level) {
   switch (level) {
   case LogLevel::LOG_ERROR:
     return "[Error]";
@@ -65,4 +242,4 @@ std::string Log::GetLevelName(LogLevel level) {
   default:
     return "[Unknown]";
   }
-}
\ No newline at end of file
+}
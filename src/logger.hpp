@@ -1,13 +1,27 @@
 #pragma once
 #include <chrono>
+#include <cstddef>
+#include <cstdint>
 #include <iomanip>
 #include <sstream>
 #include <string>
 
-#define L_INFO Log().Get(LogLevel::LOG_INFO)
-#define L_DEBUG Log().Get(LogLevel::LOG_DEBUG)
-#define L_WARN Log().Get(LogLevel::LOG_WARN)
-#define L_ERROR Log().Get(LogLevel::LOG_ERROR)
+// The level is checked before a Log is constructed, so a disabled statement
+// evaluates none of its operands. The conditional expression, unlike an
+// if/else, can't capture the else of an unbraced if around the statement.
+#define L_LOG(level)                                                           \
+  !Log::Enabled(level) ? (void)0 : LogVoidify() & Log().Get(level)
+
+#define L_INFO L_LOG(LogLevel::LOG_INFO)
+#define L_WARN L_LOG(LogLevel::LOG_WARN)
+#define L_ERROR L_LOG(LogLevel::LOG_ERROR)
+// release builds drop debug statements at compile time, the operands are
+// still type checked
+#ifdef NDEBUG
+#define L_DEBUG true ? (void)0 : LogVoidify() & Log().Get(LogLevel::LOG_DEBUG)
+#else
+#define L_DEBUG L_LOG(LogLevel::LOG_DEBUG)
+#endif
 
 enum class LogLevel {
   LOG_ERROR = 0, // level 1
@@ -17,12 +31,31 @@ enum class LogLevel {
   LOG_FULL = 4
 };
 
+// turns the stream expression into void for the other branch of L_LOG, &
+// binds looser than << so the whole statement is its operand
+struct LogVoidify {
+  void operator&(std::ostream &) {}
+};
+
 class Log {
 public:
   static LogLevel logLevel;
   static std::string timeFormat;
 
-  static void Init(LogLevel level, const std::string &timeFormat);
+  // Starts the writer thread. Lines are queued from then on and written to
+  // samp-node.log and stdout in the background, before that they are
+  // written synchronously.
+  static void Init(LogLevel level, const std::string &timeFormat,
+                   size_t queueSize = 8192);
+  // writes out what is queued and stops the writer, later lines are written
+  // synchronously again
+  static void Shutdown();
+  // waits until every line queued so far has been written
+  static void Flush();
+  // lines dropped because the queue was full
+  static uint64_t DroppedLines();
+
+  static bool Enabled(LogLevel level) { return logLevel > level; }
 
   Log();
   virtual ~Log();
@@ -32,8 +65,8 @@ protected:
   std::ostringstream os;
 
 private:
-  LogLevel currentLevel;
+  LogLevel currentLevel = LogLevel::LOG_FULL;
 
-  std::string GetLevelName(LogLevel messageLevel);
+  const char *GetLevelName(LogLevel messageLevel);
   Log(const Log &);
-};
\ No newline at end of file
+};
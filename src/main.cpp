@@ -1,32 +1,137 @@
 #include <algorithm>
+#include <cstring>
 #include <fstream>
 #include <iostream>
 
+#include "affinity.hpp"
 #include "amxhandler.hpp"
 #include "callbacks.hpp"
 #include "common.hpp"
 #include "config.hpp"
 #include "events.hpp"
+#include "hibernation.hpp"
+#include "idlegc.hpp"
+#include "jsthread.hpp"
 #include "nodeimpl.hpp"
+#include "perfstats.hpp"
+#include "playermirror.hpp"
+#include "profiler.hpp"
 #include "sampgdk.h"
+#include "spatial.hpp"
+#include "utils.hpp"
+#include "tickstats.hpp"
+#include "trace.hpp"
+#include "workers.hpp"
+
+namespace {
+// the reload itself happens on the next tick, never inside a script call
+void RequestReload() {
+  if (sampnode::jsThread.IsActive())
+    sampnode::jsThread.RequestReload();
+  else
+    sampnode::nodeImpl.RequestReload();
+}
+
+cell SAMPNode_Reload(AMX *amx, cell *params) {
+  RequestReload();
+  return 1;
+}
+
+void SetHibernating(bool hibernating) {
+  if (sampnode::jsThread.IsActive())
+    sampnode::jsThread.SetHibernating(hibernating);
+  else
+    sampnode::nodeImpl.SetHibernating(hibernating);
+}
+
+// "samp-node <command>" typed into the RCON console, true if it was ours
+bool HandleRconCommand(AMX *amx, const char *name, cell *params) {
+  if (std::strcmp(name, "OnRconCommand") != 0)
+    return false;
+
+  char *cmd;
+  amx_StrParam(amx, params[1], cmd);
+  if (cmd == nullptr)
+    return false;
+
+  if (std::strcmp(cmd, "samp-node reload") == 0) {
+    RequestReload();
+  } else if (std::strcmp(cmd, "samp-node trace start") == 0) {
+    if (!sampnode::trace::start())
+      L_WARN << "a trace is already being recorded";
+  } else if (std::strcmp(cmd, "samp-node trace stop") == 0) {
+    if (sampnode::trace::stop(utils::timestamped_file(".trace.json")).empty())
+      L_WARN << "no trace was written";
+  } else {
+    return false;
+  }
+  return true;
+}
+} // namespace
 
 const AMX_NATIVE_INFO native_list[] = {
-    {"SAMPNode_CallEvent", sampnode::event::pawn_call_event}, {0, 0}};
+    {"SAMPNode_CallEvent", sampnode::event::pawn_call_event},
+    {"SAMPNode_Reload", SAMPNode_Reload},
+    {0, 0}};
 
 PLUGIN_EXPORT bool PLUGIN_CALL OnPublicCall(AMX *amx, const char *name,
                                             cell *params, cell *retval) {
   if (sampnode::js_calling_public)
     return true;
 
-  auto iter = sampnode::events.find(name);
-  if (iter != sampnode::events.end())
-    iter->second->call(amx, params, retval, false);
+  sampnode::hibernation::on_public_call(amx, name, params);
+  sampnode::playermirror::on_public_call(amx, name, params);
+
+  if (HandleRconCommand(amx, name, params)) {
+    *retval = 1;
+    return true;
+  }
+
+  sampnode::event *_event = sampnode::event::find(name);
+  if (_event == nullptr)
+    return true;
+
+  if (sampnode::jsThread.IsActive())
+    sampnode::jsThread.DispatchEvent(_event, amx, params, retval, false);
+  else if (sampnode::nodeImpl.IsLoadingInBackground())
+    sampnode::nodeImpl.QueueEvent(_event, amx, params, false);
+  else
+    _event->call(amx, params, retval, false);
   return true;
 }
 
 PLUGIN_EXPORT void PLUGIN_CALL ProcessTick() {
+  sampnode::trace::Span span(sampnode::trace::Category::Tick, "ProcessTick");
+  sampnode::tickstats::record_interval();
   sampgdk::ProcessTick();
-  sampnode::nodeImpl.Tick();
+  sampnode::workers::process_queue();
+  // before JS runs, so this tick's queries see this tick's positions
+  if (!sampnode::hibernation::is_hibernating())
+    sampnode::spatial::refresh();
+
+  switch (sampnode::hibernation::update()) {
+  case sampnode::hibernation::Transition::Enter:
+    SetHibernating(true);
+    break;
+  case sampnode::hibernation::Transition::Leave:
+    SetHibernating(false);
+    break;
+  default:
+    break;
+  }
+
+  if (sampnode::jsThread.IsActive())
+    sampnode::jsThread.ProcessMainQueue();
+  else if (sampnode::nodeImpl.IsLoadingInBackground())
+    sampnode::nodeImpl.ProcessBackgroundLoad();
+  else if (sampnode::nodeImpl.TakeReloadRequest())
+    sampnode::nodeImpl.ReloadResource();
+  else if (!sampnode::hibernation::skip_tick()) {
+    bool ranLoop = sampnode::nodeImpl.Tick();
+    // only here, not in the ticks a listener runs while awaiting a promise
+    sampnode::profiler::on_tick(sampnode::nodeImpl.GetIsolate());
+    sampnode::idlegc::on_tick(sampnode::nodeImpl.GetIsolate(), !ranLoop);
+  }
   return;
 }
 
@@ -41,6 +146,7 @@ PLUGIN_EXPORT int PLUGIN_CALL AmxLoad(AMX *amx) {
 
 PLUGIN_EXPORT int PLUGIN_CALL AmxUnload(AMX *amx) {
   sampnode::amx::unload(amx);
+  sampnode::playermirror::on_amx_unload(amx);
   return 1;
 }
 
@@ -60,18 +166,48 @@ PLUGIN_EXPORT bool PLUGIN_CALL Load(void **ppData) {
 
   const sampnode::Props_t &mainConfigData = mainConfig.ReadAsMainConfig();
 
-  Log::Init(mainConfigData.log_level, mainConfigData.timestamp_format);
+  Log::Init(mainConfigData.log_level, mainConfigData.timestamp_format,
+            mainConfigData.log_queue_size);
 
   L_INFO << "plugin is using samp-node.json config file";
 
   sampgdk::Load(ppData);
-  sampnode::nodeImpl.Initialize(mainConfigData);
-  sampnode::nodeImpl.LoadResource();
+  sampnode::hibernation::init(mainConfigData);
+  sampnode::playermirror::init(mainConfigData);
+  sampnode::spatial::init(mainConfigData);
+  sampnode::perfstats::init(mainConfigData);
+  sampnode::trace::init(mainConfigData);
+  sampnode::trace::set_thread_name("server");
+
+  if (mainConfigData.threaded_runtime) {
+    sampnode::jsThread.Start(mainConfigData);
+  } else if (mainConfigData.background_init) {
+    sampnode::nodeImpl.LoadInBackground(mainConfigData);
+  } else {
+    sampnode::nodeImpl.Initialize(mainConfigData);
+    sampnode::nodeImpl.LoadResource();
+  }
+
+  // pinned last, so a threaded runtime's JS thread doesn't inherit the mask
+  if (!mainConfigData.server_cpus.empty()) {
+    if (sampnode::affinity::pin_current_thread(mainConfigData.server_cpus))
+      L_INFO << "server thread pinned to cpus "
+             << sampnode::affinity::to_string(mainConfigData.server_cpus);
+    else
+      L_WARN << "could not pin the server thread to cpus "
+             << sampnode::affinity::to_string(mainConfigData.server_cpus);
+  }
   return true;
 }
 
 PLUGIN_EXPORT void PLUGIN_CALL Unload() {
-  sampnode::nodeImpl.Stop();
+  if (sampnode::jsThread.IsActive())
+    sampnode::jsThread.Stop();
+  else
+    sampnode::nodeImpl.Stop();
+  sampnode::workers::shutdown();
+  sampnode::perfstats::shutdown();
   sampgdk::Unload();
+  Log::Shutdown();
   return;
 }
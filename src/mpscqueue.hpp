@@ -0,0 +1,67 @@
+#pragma once
+#include <atomic>
+#include <cstddef>
+#include <memory>
+
+namespace sampnode {
+// Bounded lock-free ring buffer for any number of producer threads and exactly
+// one consumer thread. Every slot carries a sequence number so producers only
+// contend on the tail counter. Capacity is rounded up to a power of two.
+template <typename T> class MpscQueue {
+public:
+  explicit MpscQueue(size_t capacity) {
+    size_t size = 2;
+    while (size < capacity)
+      size <<= 1;
+    buffer.reset(new Slot[size]);
+    for (size_t i = 0; i < size; i++)
+      buffer[i].sequence.store(i, std::memory_order_relaxed);
+    mask = size - 1;
+  }
+
+  // producer side, returns false when the queue is full
+  bool push(const T &value) {
+    size_t t = tail.load(std::memory_order_relaxed);
+    Slot *slot;
+    for (;;) {
+      slot = &buffer[t & mask];
+      const size_t seq = slot->sequence.load(std::memory_order_acquire);
+      const intptr_t diff = static_cast<intptr_t>(seq) - static_cast<intptr_t>(t);
+      if (diff == 0) {
+        if (tail.compare_exchange_weak(t, t + 1, std::memory_order_relaxed))
+          break;
+      } else if (diff < 0) {
+        return false;
+      } else {
+        t = tail.load(std::memory_order_relaxed);
+      }
+    }
+    slot->value = value;
+    slot->sequence.store(t + 1, std::memory_order_release);
+    return true;
+  }
+
+  // consumer side, returns false when the queue is empty
+  bool pop(T &value) {
+    const size_t h = head.load(std::memory_order_relaxed);
+    Slot &slot = buffer[h & mask];
+    if (slot.sequence.load(std::memory_order_acquire) != h + 1)
+      return false;
+    value = slot.value;
+    slot.sequence.store(h + mask + 1, std::memory_order_release);
+    head.store(h + 1, std::memory_order_relaxed);
+    return true;
+  }
+
+private:
+  struct Slot {
+    std::atomic<size_t> sequence;
+    T value;
+  };
+
+  std::unique_ptr<Slot[]> buffer;
+  size_t mask;
+  alignas(64) std::atomic<size_t> head{0};
+  alignas(64) std::atomic<size_t> tail{0};
+};
+} // namespace sampnode
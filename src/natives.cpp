@@ -1,15 +1,41 @@
 #include "natives.hpp"
 
+#include <algorithm>
+#include <memory>
 #include <string>
 #include <unordered_map>
 #include <vector>
 
 #include "common.hpp"
+#include "errorlog.hpp"
+#include "jsthread.hpp"
+#include "nodeimpl.hpp"
+#include "perfstats.hpp"
 #include "sampgdk.h"
+#include "trace.hpp"
+#include "watchdog.hpp"
 
 namespace sampnode {
 std::unordered_map<std::string, AMX_NATIVE> pawn_natives_cache;
 
+namespace {
+cell *alloc_cells(native::NativeCall_t &call, size_t size) {
+  call.cellBuffers.emplace_back(new cell[size]());
+  return call.cellBuffers.back().get();
+}
+
+char *alloc_string(native::NativeCall_t &call, v8::Isolate *isolate,
+                   v8::Local<v8::Value> value) {
+  v8::String::Utf8Value _str(isolate, value);
+  std::string_view str(*_str);
+  char *mystr = new char[str.length() + 1];
+  std::copy(str.begin(), str.end(), mystr);
+  mystr[str.length()] = '\0';
+  call.charBuffers.emplace_back(mystr);
+  return mystr;
+}
+} // namespace
+
 AMX_NATIVE native::get_address(const std::string &name) {
   if (auto iter = pawn_natives_cache.find(name);
       iter != pawn_natives_cache.end()) {
@@ -23,46 +49,32 @@ AMX_NATIVE native::get_address(const std::string &name) {
   return native;
 }
 
-void native::call(const v8::FunctionCallbackInfo<v8::Value> &args) {
+bool native::prepare(const v8::FunctionCallbackInfo<v8::Value> &args,
+                     NativeCall_t &call) {
   v8::Isolate *isolate = args.GetIsolate();
-  v8::Locker locker(isolate);
-  v8::Isolate::Scope isolateScope(isolate);
-
   auto _context = isolate->GetCurrentContext();
-  v8::Context::Scope contextScope(_context);
-
-  v8::TryCatch eh(isolate);
 
   v8::String::Utf8Value str(isolate, args[0]);
-  std::string name(*str);
+  call.name = *str;
 
   v8::String::Utf8Value str2(isolate, args[1]);
-  std::string_view format(*str2);
+  call.format = *str2;
 
-  if (format == "undefined") {
-    format = "";
+  if (call.format == "undefined") {
+    call.format = "";
   }
 
-  AMX_NATIVE native = get_address(name);
-  if (!native) {
-    L_ERROR << "[callNative] native function: " << name << " not found.";
-    return;
-  }
-
-  void *params[32];
-  cell param_value[32];
-  int param_size[32];
+  std::string_view format(call.format);
+  const std::string &name = call.name;
+  void **params = call.params;
+  cell *param_value = call.values;
+  int *param_size = call.sizes;
+  std::string &str_format = call.invokeFormat;
   int j = 0;
   int k = 2;
-  int vars = 0;
-  int strs = 0;
-  int strv = 0;
 
   bool variadic = false;
-  std::string variadic_types;
-  std::vector<void *> variadic_allocs;
 
-  std::string str_format;
   for (size_t fi = 0; fi < format.length(); fi++) {
     char c = format[fi];
     switch (c) {
@@ -87,16 +99,11 @@ void native::call(const v8::FunctionCallbackInfo<v8::Value> &args) {
     } break;
 
     case 's': {
-      v8::String::Utf8Value _str(isolate, args[k]);
-      std::string_view str(*_str);
-      char *mystr = new char[str.length() + 1];
-      std::copy(str.begin(), str.end(), mystr);
-      mystr[str.length()] = '\0';
-      params[j] = static_cast<void *>(mystr);
+      params[j] = static_cast<void *>(alloc_string(call, isolate, args[k]));
       j++;
       k++;
       str_format += 's';
-      strs++;
+      call.strs++;
     } break;
 
     case 'a': {
@@ -104,13 +111,13 @@ void native::call(const v8::FunctionCallbackInfo<v8::Value> &args) {
         args.GetReturnValue().Set(false);
         L_ERROR << "callNative: '" << name << "', parameter " << k
                 << "must be an array";
-        return;
+        return false;
       }
 
       v8::Local<v8::Array> a = v8::Local<v8::Array>::Cast(args[k++]);
       size_t size = a->Length();
 
-      cell *value = new cell[size];
+      cell *value = alloc_cells(call, size);
       for (size_t b = 0; b < size; b++) {
         value[b] = a->Get(_context, b)
                        .ToLocalChecked()
@@ -120,7 +127,7 @@ void native::call(const v8::FunctionCallbackInfo<v8::Value> &args) {
 
       str_format += "a[" + std::to_string(size) + "]";
       params[j++] = static_cast<void *>(value);
-      strs++;
+      call.strs++;
     } break;
 
     case 'v': {
@@ -128,13 +135,13 @@ void native::call(const v8::FunctionCallbackInfo<v8::Value> &args) {
         args.GetReturnValue().Set(false);
         L_ERROR << "callNative: '" << name << "', parameter " << k
                 << "must be an array";
-        return;
+        return false;
       }
 
       v8::Local<v8::Array> a = v8::Local<v8::Array>::Cast(args[k++]);
       size_t size = a->Length();
 
-      cell *value = new cell[size];
+      cell *value = alloc_cells(call, size);
       for (size_t b = 0; b < size; b++) {
         float val = static_cast<float>(a->Get(_context, b)
                                            .ToLocalChecked()
@@ -145,7 +152,7 @@ void native::call(const v8::FunctionCallbackInfo<v8::Value> &args) {
 
       str_format += "a[" + std::to_string(size) + "]";
       params[j++] = static_cast<void *>(value);
-      strs++;
+      call.strs++;
     } break;
 
     case 'F':
@@ -153,46 +160,35 @@ void native::call(const v8::FunctionCallbackInfo<v8::Value> &args) {
       param_value[j] = 0;
       params[j] = static_cast<void *>(&param_value[j]);
       j++;
-      vars++;
+      call.vars++;
       str_format += 'R';
     } break;
 
-    case 'A': {
-      const int size = args[k]->Int32Value(_context).ToChecked();
-      param_size[j] = size;
-      cell *value = new cell[size]();
-      params[j] = static_cast<void *>(value);
-      j++;
-      str_format += "A[" + std::to_string(size) + "]";
-      vars++;
-    } break;
-
+    case 'A':
     case 'V': {
+      // float 0.0f and integer 0 share the same cell representation
       const int size = args[k]->Int32Value(_context).ToChecked();
       param_size[j] = size;
-      cell *value = new cell[size];
-      float val = 0.0f;
-      for (int c = 0; c < size; c++) {
-        value[c] = amx_ftoc(val);
-      }
-      params[j] = static_cast<void *>(value);
+      params[j] = static_cast<void *>(alloc_cells(call, size));
       j++;
       str_format += "A[" + std::to_string(size) + "]";
-      vars++;
+      call.vars++;
     } break;
 
     case 'S': {
       unsigned int strl = args[k]->Int32Value(_context).ToChecked();
       if (strl < 1) {
         L_ERROR << "callNative: '" << name << "' - String length can't be 0";
-        return;
+        return false;
       }
 
       param_size[j] = static_cast<cell>(strl);
       str_format += "S[" + std::to_string(strl) + "]";
-      params[j] = new char[strl]();
+      char *value = new char[strl]();
+      call.charBuffers.emplace_back(value);
+      params[j] = value;
       j++;
-      vars++;
+      call.vars++;
     } break;
 
     case 'r':
@@ -200,7 +196,8 @@ void native::call(const v8::FunctionCallbackInfo<v8::Value> &args) {
       if (fi + 1 < format.length() && format[fi + 1] == '[') {
         auto close = format.find(']', fi + 2);
         if (close != std::string_view::npos) {
-          variadic_types = std::string(format.substr(fi + 2, close - fi - 2));
+          call.variadicTypes =
+              std::string(format.substr(fi + 2, close - fi - 2));
         }
       }
       break;
@@ -212,7 +209,7 @@ void native::call(const v8::FunctionCallbackInfo<v8::Value> &args) {
   if (variadic) {
     bool pendingSize = false;
 
-    for (char vc : variadic_types) {
+    for (char vc : call.variadicTypes) {
       switch (vc) {
       case 'i':
       case 'd': {
@@ -240,13 +237,7 @@ void native::call(const v8::FunctionCallbackInfo<v8::Value> &args) {
       } break;
 
       case 's': {
-        v8::String::Utf8Value _str(isolate, args[k]);
-        std::string_view sv(*_str);
-        char *mystr = new char[sv.length() + 1];
-        std::copy(sv.begin(), sv.end(), mystr);
-        mystr[sv.length()] = '\0';
-        params[j] = static_cast<void *>(mystr);
-        variadic_allocs.push_back(mystr);
+        params[j] = static_cast<void *>(alloc_string(call, isolate, args[k]));
         k++;
         if (!pendingSize) {
           j++;
@@ -259,12 +250,11 @@ void native::call(const v8::FunctionCallbackInfo<v8::Value> &args) {
         if (!args[k]->IsArray()) {
           L_ERROR << "callNative: '" << name
                   << "' variadic 'a' requires an array";
-          return;
+          return false;
         }
         v8::Local<v8::Array> a = v8::Local<v8::Array>::Cast(args[k]);
         size_t size = a->Length();
-        cell *value = new cell[size];
-        variadic_allocs.push_back(value);
+        cell *value = alloc_cells(call, size);
         for (size_t b = 0; b < size; b++)
           value[b] = a->Get(_context, b)
                          .ToLocalChecked()
@@ -281,12 +271,11 @@ void native::call(const v8::FunctionCallbackInfo<v8::Value> &args) {
         if (!args[k]->IsArray()) {
           L_ERROR << "callNative: '" << name
                   << "' variadic 'v' requires an array";
-          return;
+          return false;
         }
         v8::Local<v8::Array> a = v8::Local<v8::Array>::Cast(args[k]);
         size_t size = a->Length();
-        cell *value = new cell[size];
-        variadic_allocs.push_back(value);
+        cell *value = alloc_cells(call, size);
         for (size_t b = 0; b < size; b++) {
           float fval = static_cast<float>(a->Get(_context, b)
                                               .ToLocalChecked()
@@ -302,47 +291,22 @@ void native::call(const v8::FunctionCallbackInfo<v8::Value> &args) {
       } break;
 
       case 'I':
-      case 'D': {
-        param_value[j] = 0;
-        params[j] = static_cast<void *>(&param_value[j]);
-        j++;
-        vars++;
-        str_format += 'R';
-      } break;
-
+      case 'D':
       case 'F': {
         param_value[j] = 0;
         params[j] = static_cast<void *>(&param_value[j]);
         j++;
-        vars++;
+        call.vars++;
         str_format += 'R';
       } break;
 
-      case 'A': {
-        int size = args[k]->Int32Value(_context).ToChecked();
-        param_size[j] = size;
-        cell *value = new cell[size]();
-        variadic_allocs.push_back(value);
-        params[j] = static_cast<void *>(value);
-        j++;
-        vars++;
-        str_format += "A[" + std::to_string(size) + "]";
-        pendingSize = true;
-      } break;
-
+      case 'A':
       case 'V': {
         int size = args[k]->Int32Value(_context).ToChecked();
         param_size[j] = size;
-        cell *value = new cell[size];
-        {
-          float fval = 0.0f;
-          for (int c = 0; c < size; c++)
-            value[c] = amx_ftoc(fval);
-        }
-        variadic_allocs.push_back(value);
-        params[j] = static_cast<void *>(value);
+        params[j] = static_cast<void *>(alloc_cells(call, size));
         j++;
-        vars++;
+        call.vars++;
         str_format += "A[" + std::to_string(size) + "]";
         pendingSize = true;
       } break;
@@ -351,15 +315,15 @@ void native::call(const v8::FunctionCallbackInfo<v8::Value> &args) {
         int strl = args[k]->Int32Value(_context).ToChecked();
         if (strl < 1) {
           L_ERROR << "callNative: '" << name << "' - String length can't be 0";
-          return;
+          return false;
         }
         param_size[j] = static_cast<cell>(strl);
         char *mystr = new char[strl]();
-        variadic_allocs.push_back(mystr);
+        call.charBuffers.emplace_back(mystr);
         str_format += "S[" + std::to_string(strl) + "]";
         params[j] = static_cast<void *>(mystr);
         j++;
-        vars++;
+        call.vars++;
       } break;
 
       default:
@@ -368,181 +332,418 @@ void native::call(const v8::FunctionCallbackInfo<v8::Value> &args) {
     }
   }
 
-  int32_t retval =
-      sampgdk::InvokeNativeArray(native, str_format.c_str(), params);
+  return true;
+}
+
+void native::invoke(NativeCall_t &call) {
+  trace::Span span(trace::Category::Native, call.name.c_str());
+  call.native = get_address(call.name);
+  if (!call.native) {
+    L_ERROR << "[callNative] native function: " << call.name << " not found.";
+    return;
+  }
 
-  if (vars > 0 || strs > 0) {
-    v8::Local<v8::Array> arr = v8::Array::New(isolate, vars);
-    int var_index = 0;
-    j = 0;
+  call.retval = sampgdk::InvokeNativeArray(
+      call.native, call.invokeFormat.c_str(), call.params);
+}
 
-    for (size_t fi = 0; fi < format.length(); fi++) {
-      char c = format[fi];
-      switch (c) {
-      case '[':
-        while (fi < format.length() && format[fi] != ']')
-          fi++;
-        break;
-      case ']':
-        break;
-      case 'i':
-      case 'f': {
-        j++;
-      } break;
+v8::Local<v8::Value> native::result(v8::Isolate *isolate,
+                                    v8::Local<v8::Context> _context,
+                                    NativeCall_t &call) {
+  if (!call.native)
+    return v8::Undefined(isolate);
 
-      case 's':
-      case 'a':
-      case 'v': {
-        delete[] static_cast<char *>(params[j++]);
-      } break;
+  if (call.vars == 0 && call.strs == 0)
+    return v8::Integer::New(isolate, call.retval);
 
-      case 'A': {
-        int size = param_size[j];
-        v8::Local<v8::Array> rArr = v8::Array::New(isolate, size);
-        cell *prams = static_cast<cell *>(params[j]);
-        for (int c = 0; c < size; c++) {
-          rArr->Set(_context, c, v8::Integer::New(isolate, prams[c])).Check();
-        }
-        arr->Set(_context, var_index++, rArr).Check();
-        delete[] static_cast<char *>(params[j++]);
-      } break;
+  std::string_view format(call.format);
+  void **params = call.params;
+  int *param_size = call.sizes;
 
-      case 'V': {
-        cell *param_array = static_cast<cell *>(params[j]);
-        int size = param_size[j];
-        v8::Local<v8::Array> rArr = v8::Array::New(isolate, size);
-        for (int c = 0; c < size; c++) {
-          rArr->Set(_context, c,
-                    v8::Number::New(isolate, amx_ctof(param_array[c])))
-              .Check();
-        }
-        arr->Set(_context, var_index++, rArr).Check();
-        delete[] static_cast<char *>(params[j++]);
-      } break;
+  v8::Local<v8::Array> arr = v8::Array::New(isolate, call.vars);
+  int var_index = 0;
+  int j = 0;
 
-      case 'I': {
-        int val = *static_cast<cell *>(params[j++]);
-        arr->Set(_context, var_index++, v8::Integer::New(isolate, val)).Check();
-      } break;
+  for (size_t fi = 0; fi < format.length(); fi++) {
+    char c = format[fi];
+    switch (c) {
+    case '[':
+      while (fi < format.length() && format[fi] != ']')
+        fi++;
+      break;
+    case ']':
+      break;
+    case 'i':
+    case 'f':
+    case 's':
+    case 'a':
+    case 'v': {
+      j++;
+    } break;
 
-      case 'F': {
-        float val = amx_ctof(*static_cast<cell *>(params[j++]));
-        arr->Set(_context, var_index++, v8::Number::New(isolate, val)).Check();
-      } break;
+    case 'A': {
+      int size = param_size[j];
+      v8::Local<v8::Array> rArr = v8::Array::New(isolate, size);
+      cell *prams = static_cast<cell *>(params[j]);
+      for (int c = 0; c < size; c++) {
+        rArr->Set(_context, c, v8::Integer::New(isolate, prams[c])).Check();
+      }
+      arr->Set(_context, var_index++, rArr).Check();
+      j++;
+    } break;
 
-      case 'S': {
-        size_t s_len = param_size[j];
-        char *s_str = static_cast<char *>(params[j]);
-        s_str[s_len - 1] = '\0';
-        arr->Set(_context, var_index++,
-                 v8::String::NewFromUtf8(isolate, s_str).ToLocalChecked())
+    case 'V': {
+      cell *param_array = static_cast<cell *>(params[j]);
+      int size = param_size[j];
+      v8::Local<v8::Array> rArr = v8::Array::New(isolate, size);
+      for (int c = 0; c < size; c++) {
+        rArr->Set(_context, c,
+                  v8::Number::New(isolate, amx_ctof(param_array[c])))
             .Check();
-        delete[] static_cast<char *>(params[j++]);
-      } break;
+      }
+      arr->Set(_context, var_index++, rArr).Check();
+      j++;
+    } break;
 
-      case 'r': {
-        bool pendingSize = false;
-
-        for (char vc : variadic_types) {
-          switch (vc) {
-          case 'i':
-          case 'd':
-          case 'f':
-          case 's':
-          case 'a':
-          case 'v':
-            if (!pendingSize)
-              j++;
-            pendingSize = false;
-            break;
-          case 'I':
-          case 'D': {
-            int val = *static_cast<cell *>(params[j++]);
-            arr->Set(_context, var_index++, v8::Integer::New(isolate, val))
-                .Check();
-          } break;
-          case 'F': {
-            float val = amx_ctof(*static_cast<cell *>(params[j++]));
-            arr->Set(_context, var_index++, v8::Number::New(isolate, val))
-                .Check();
-          } break;
-          case 'A': {
-            int size = param_size[j];
-            v8::Local<v8::Array> rArr = v8::Array::New(isolate, size);
-            cell *prams = static_cast<cell *>(params[j]);
-            for (int c = 0; c < size; c++)
-              rArr->Set(_context, c, v8::Integer::New(isolate, prams[c]))
-                  .Check();
-            arr->Set(_context, var_index++, rArr).Check();
-            j++;
-            pendingSize = true;
-          } break;
-          case 'V': {
-            cell *param_array = static_cast<cell *>(params[j]);
-            int size = param_size[j];
-            v8::Local<v8::Array> rArr = v8::Array::New(isolate, size);
-            for (int c = 0; c < size; c++)
-              rArr->Set(_context, c,
-                        v8::Number::New(isolate, amx_ctof(param_array[c])))
-                  .Check();
-            arr->Set(_context, var_index++, rArr).Check();
+    case 'I': {
+      int val = *static_cast<cell *>(params[j++]);
+      arr->Set(_context, var_index++, v8::Integer::New(isolate, val)).Check();
+    } break;
+
+    case 'F': {
+      float val = amx_ctof(*static_cast<cell *>(params[j++]));
+      arr->Set(_context, var_index++, v8::Number::New(isolate, val)).Check();
+    } break;
+
+    case 'S': {
+      size_t s_len = param_size[j];
+      char *s_str = static_cast<char *>(params[j]);
+      s_str[s_len - 1] = '\0';
+      arr->Set(_context, var_index++,
+               v8::String::NewFromUtf8(isolate, s_str).ToLocalChecked())
+          .Check();
+      j++;
+    } break;
+
+    case 'r': {
+      bool pendingSize = false;
+
+      for (char vc : call.variadicTypes) {
+        switch (vc) {
+        case 'i':
+        case 'd':
+        case 'f':
+        case 's':
+        case 'a':
+        case 'v':
+          if (!pendingSize)
             j++;
-            pendingSize = true;
-          } break;
-          case 'S': {
-            size_t s_len = param_size[j];
-            char *s_str = static_cast<char *>(params[j]);
-            s_str[s_len - 1] = '\0';
-            arr->Set(_context, var_index++,
-                     v8::String::NewFromUtf8(isolate, s_str).ToLocalChecked())
+          pendingSize = false;
+          break;
+        case 'I':
+        case 'D': {
+          int val = *static_cast<cell *>(params[j++]);
+          arr->Set(_context, var_index++, v8::Integer::New(isolate, val))
+              .Check();
+        } break;
+        case 'F': {
+          float val = amx_ctof(*static_cast<cell *>(params[j++]));
+          arr->Set(_context, var_index++, v8::Number::New(isolate, val))
+              .Check();
+        } break;
+        case 'A': {
+          int size = param_size[j];
+          v8::Local<v8::Array> rArr = v8::Array::New(isolate, size);
+          cell *prams = static_cast<cell *>(params[j]);
+          for (int c = 0; c < size; c++)
+            rArr->Set(_context, c, v8::Integer::New(isolate, prams[c]))
                 .Check();
-            j++;
-          } break;
-          default:
-            j++;
-            break;
-          }
+          arr->Set(_context, var_index++, rArr).Check();
+          j++;
+          pendingSize = true;
+        } break;
+        case 'V': {
+          cell *param_array = static_cast<cell *>(params[j]);
+          int size = param_size[j];
+          v8::Local<v8::Array> rArr = v8::Array::New(isolate, size);
+          for (int c = 0; c < size; c++)
+            rArr->Set(_context, c,
+                      v8::Number::New(isolate, amx_ctof(param_array[c])))
+                .Check();
+          arr->Set(_context, var_index++, rArr).Check();
+          j++;
+          pendingSize = true;
+        } break;
+        case 'S': {
+          size_t s_len = param_size[j];
+          char *s_str = static_cast<char *>(params[j]);
+          s_str[s_len - 1] = '\0';
+          arr->Set(_context, var_index++,
+                   v8::String::NewFromUtf8(isolate, s_str).ToLocalChecked())
+              .Check();
+          j++;
+        } break;
+        default:
+          j++;
+          break;
         }
-      } break;
       }
+    } break;
     }
+  }
 
-    if (var_index >= 1) {
-      arr->Set(_context, var_index, v8::Integer::New(isolate, retval)).Check();
-      args.GetReturnValue().Set(arr);
-    } else {
-      args.GetReturnValue().Set(retval);
-    }
-  } else {
-    args.GetReturnValue().Set(retval);
+  if (var_index >= 1) {
+    arr->Set(_context, var_index, v8::Integer::New(isolate, call.retval))
+        .Check();
+    return arr;
   }
+  return v8::Integer::New(isolate, call.retval);
+}
+
+v8::Local<v8::Value> native::to_float(v8::Isolate *isolate,
+                                      v8::Local<v8::Context> context,
+                                      v8::Local<v8::Value> value) {
+  if (value->IsUndefined())
+    return value;
+
+  int32_t retval = value->Int32Value(context).ToChecked();
+  return v8::Number::New(isolate, amx_ctof(retval));
+}
+
+void native::call(const v8::FunctionCallbackInfo<v8::Value> &args) {
+  v8::Isolate *isolate = args.GetIsolate();
+  v8::Locker locker(isolate);
+  v8::Isolate::Scope isolateScope(isolate);
+
+  auto _context = isolate->GetCurrentContext();
+  v8::Context::Scope contextScope(_context);
 
-  for (auto *ptr : variadic_allocs) {
-    delete[] static_cast<char *>(ptr);
+  if (jsThread.IsActive()) {
+    jsThread.CallNative(args, false);
+    return;
   }
 
-  if (eh.HasCaught()) {
-    v8::String::Utf8Value error(isolate, eh.Exception());
-    v8::String::Utf8Value stack(isolate,
-                                eh.StackTrace(_context).ToLocalChecked());
-    L_ERROR << "[samp-node] event handling function in resource: " << *error
-            << "\nstack:\n"
-            << *stack << "\n";
+  v8::TryCatch eh(isolate);
+
+  uint64_t start = perfstats::enabled ? perfstats::now_ns() : 0;
+  NativeCall_t call;
+  if (prepare(args, call)) {
+    uint64_t prepared = perfstats::enabled ? perfstats::now_ns() : 0;
+    {
+      watchdog::Scope watchdogScope(watchdog::Kind::Native, call.name.c_str());
+      nodeImpl.RunOnServerThread([&call] { invoke(call); });
+    }
+    uint64_t invoked = perfstats::enabled ? perfstats::now_ns() : 0;
+
+    if (call.native)
+      args.GetReturnValue().Set(result(isolate, _context, call));
+
+    if (perfstats::enabled && call.native)
+      perfstats::native_counter(call.name)
+          ->record(invoked - prepared,
+                   (prepared - start) + (perfstats::now_ns() - invoked));
   }
+
+  if (eh.HasCaught())
+    errorlog::report(isolate, _context, eh, "native " + call.name);
 }
 
 void native::call_float(const v8::FunctionCallbackInfo<v8::Value> &args) {
+  if (jsThread.IsActive()) {
+    jsThread.CallNative(args, true);
+    return;
+  }
+
   call(args);
 
   v8::Isolate *isolate = args.GetIsolate();
   v8::HandleScope handleScope(isolate);
   v8::Local<v8::Context> context = isolate->GetCurrentContext();
 
-  v8::Local<v8::Value> retVal = args.GetReturnValue().Get();
+  args.GetReturnValue().Set(
+      to_float(isolate, context, args.GetReturnValue().Get()));
+}
+
+namespace {
+// Setters samp.applyBatch can call. Per call the format takes its ints from
+// ids, its floats from values and its strings from strings, in order.
+struct BatchOp_t {
+  const char *name;
+  const char *format;
+  int ints;
+  int floats;
+  int strings;
+};
+
+const BatchOp_t batchOps[] = {
+    {"SetPlayerPos", "ifff", 1, 3, 0},
+    {"SetPlayerFacingAngle", "if", 1, 1, 0},
+    {"SetPlayerVelocity", "ifff", 1, 3, 0},
+    {"SetPlayerHealth", "if", 1, 1, 0},
+    {"SetPlayerArmour", "if", 1, 1, 0},
+    {"SetPlayerVirtualWorld", "ii", 2, 0, 0},
+    {"SetPlayerInterior", "ii", 2, 0, 0},
+    {"SetPlayerColor", "ii", 2, 0, 0},
+    {"SetPlayerMarkerForPlayer", "iii", 3, 0, 0},
+    {"SetVehiclePos", "ifff", 1, 3, 0},
+    {"SetVehicleZAngle", "if", 1, 1, 0},
+    {"SetVehicleVelocity", "ifff", 1, 3, 0},
+    {"SetVehicleHealth", "if", 1, 1, 0},
+    {"SetVehicleVirtualWorld", "ii", 2, 0, 0},
+    {"SetObjectPos", "ifff", 1, 3, 0},
+    {"SetObjectRot", "ifff", 1, 3, 0},
+    {"SetPlayerObjectPos", "iifff", 2, 3, 0},
+    {"SetPlayerObjectRot", "iifff", 2, 3, 0},
+    {"TextDrawSetString", "is", 1, 0, 1},
+    {"TextDrawColor", "ii", 2, 0, 0},
+    {"PlayerTextDrawSetString", "iis", 2, 0, 1},
+    {"PlayerTextDrawColor", "iii", 3, 0, 0},
+};
+
+// the arguments are copied, JS may change its arrays while the batch waits
+// for the server thread
+struct Batch_t {
+  const BatchOp_t *op = nullptr;
+  int count = 0;
+  std::vector<int32_t> ints;
+  std::vector<float> floats;
+  std::vector<std::string> strings;
+  int applied = 0;
+};
+
+const BatchOp_t *find_batch_op(const std::string &name) {
+  for (const BatchOp_t &op : batchOps) {
+    if (name == op.name)
+      return &op;
+  }
+  return nullptr;
+}
+
+bool prepare_batch(const v8::FunctionCallbackInfo<v8::Value> &info,
+                   Batch_t &batch) {
+  v8::Isolate *isolate = info.GetIsolate();
+  v8::Local<v8::Context> context = isolate->GetCurrentContext();
+
+  if (info.Length() < 2 || !info[0]->IsString()) {
+    L_ERROR << "applyBatch: expected (op, ids, values?, strings?)";
+    return false;
+  }
+
+  v8::String::Utf8Value name(isolate, info[0]);
+  batch.op = find_batch_op(*name);
+  if (batch.op == nullptr) {
+    L_ERROR << "applyBatch: unknown op " << *name;
+    return false;
+  }
+  const BatchOp_t &op = *batch.op;
+
+  if (!info[1]->IsInt32Array()) {
+    L_ERROR << "applyBatch: " << op.name << " expects an Int32Array of ids";
+    return false;
+  }
+  v8::Local<v8::Int32Array> ids = info[1].As<v8::Int32Array>();
+  batch.ints.resize(ids->Length());
+  ids->CopyContents(batch.ints.data(), batch.ints.size() * sizeof(int32_t));
+  batch.count = static_cast<int>(batch.ints.size()) / op.ints;
+
+  if (op.floats > 0) {
+    if (info.Length() < 3 || !info[2]->IsFloat32Array()) {
+      L_ERROR << "applyBatch: " << op.name << " expects a Float32Array";
+      return false;
+    }
+    v8::Local<v8::Float32Array> values = info[2].As<v8::Float32Array>();
+    batch.floats.resize(values->Length());
+    values->CopyContents(batch.floats.data(),
+                         batch.floats.size() * sizeof(float));
+    batch.count = std::min(
+        batch.count, static_cast<int>(batch.floats.size()) / op.floats);
+  }
+
+  if (op.strings > 0) {
+    if (info.Length() < 4 || !info[3]->IsArray()) {
+      L_ERROR << "applyBatch: " << op.name << " expects an array of strings";
+      return false;
+    }
+    v8::Local<v8::Array> strings = info[3].As<v8::Array>();
+    uint32_t length = strings->Length();
+    batch.count = std::min(batch.count,
+                           static_cast<int>(length) / op.strings);
+    batch.strings.reserve(batch.count * op.strings);
+    for (int i = 0; i < batch.count * op.strings; i++) {
+      v8::Local<v8::Value> value;
+      if (!strings->Get(context, i).ToLocal(&value))
+        return false;
+      v8::String::Utf8Value str(isolate, value);
+      batch.strings.emplace_back(*str ? *str : "");
+    }
+  }
+  return true;
+}
+
+// server thread
+void apply(Batch_t &batch) {
+  const BatchOp_t &op = *batch.op;
+  trace::Span span(trace::Category::Native, op.name);
+
+  AMX_NATIVE native = native::get_address(op.name);
+  if (!native) {
+    L_ERROR << "applyBatch: native function " << op.name << " not found.";
+    return;
+  }
+
+  void *params[8];
+  for (int i = 0; i < batch.count; i++) {
+    int32_t *ints = &batch.ints[i * op.ints];
+    float *floats = op.floats > 0 ? &batch.floats[i * op.floats] : nullptr;
+    std::string *strings =
+        op.strings > 0 ? &batch.strings[i * op.strings] : nullptr;
+
+    int p = 0;
+    for (const char *c = op.format; *c != '\0'; c++) {
+      if (*c == 'i')
+        params[p++] = ints++;
+      else if (*c == 'f')
+        params[p++] = floats++;
+      else
+        params[p++] = const_cast<char *>((strings++)->c_str());
+    }
+    sampgdk::InvokeNativeArray(native, op.format, params);
+  }
+  batch.applied = batch.count;
+}
+
+struct DeferredBatch_t : Deferred_t {
+  Batch_t batch;
+
+  void Invoke() override { apply(batch); }
+
+  v8::Local<v8::Value> Result(v8::Isolate *isolate,
+                              v8::Local<v8::Context> context) override {
+    return v8::Integer::New(isolate, batch.applied);
+  }
+};
+} // namespace
+
+void native::apply_batch(const v8::FunctionCallbackInfo<v8::Value> &info) {
+  v8::Isolate *isolate = info.GetIsolate();
+  v8::HandleScope handleScope(isolate);
+
+  auto task = std::make_unique<DeferredBatch_t>();
+  if (!prepare_batch(info, task->batch)) {
+    info.GetReturnValue().Set(-1);
+    return;
+  }
+
+  if (jsThread.IsActive()) {
+    jsThread.Defer(info, std::move(task));
+    return;
+  }
 
-  if (!retVal->IsUndefined()) {
-    int32_t retval = retVal->Int32Value(context).ToChecked();
-    args.GetReturnValue().Set(amx_ctof(retval));
+  {
+    watchdog::Scope watchdogScope(watchdog::Kind::Native, task->batch.op->name);
+    Batch_t &batch = task->batch;
+    nodeImpl.RunOnServerThread([&batch] { apply(batch); });
   }
+  info.GetReturnValue().Set(task->batch.applied);
 }
-} // namespace sampnode
\ No newline at end of file
+} // namespace sampnode
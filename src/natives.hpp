@@ -1,6 +1,8 @@
 #pragma once
 
+#include <memory>
 #include <string>
+#include <vector>
 
 #include "amx/amx.h"
 #include "node.h"
@@ -8,8 +10,39 @@
 
 namespace sampnode {
 namespace native {
+// A native call split into the parts that need V8 (prepare/result) and the
+// part that needs the server thread (invoke), so it can be queued between them.
+struct NativeCall_t {
+  std::string name;
+  std::string format;
+  std::string variadicTypes;
+  std::string invokeFormat;
+  AMX_NATIVE native = nullptr;
+  void *params[32];
+  cell values[32];
+  int sizes[32];
+  int vars = 0;
+  int strs = 0;
+  int32_t retval = 0;
+  std::vector<std::unique_ptr<cell[]>> cellBuffers;
+  std::vector<std::unique_ptr<char[]>> charBuffers;
+};
+
 void call(const v8::FunctionCallbackInfo<v8::Value> &args);
 void call_float(const v8::FunctionCallbackInfo<v8::Value> &args);
+// samp.applyBatch(op, ids, values?, strings?) calls one setter from a fixed
+// table for every entry, with one transition into the plugin per batch
+void apply_batch(const v8::FunctionCallbackInfo<v8::Value> &info);
 AMX_NATIVE get_address(const std::string &name);
+
+bool prepare(const v8::FunctionCallbackInfo<v8::Value> &args,
+             NativeCall_t &call);
+void invoke(NativeCall_t &call);
+v8::Local<v8::Value> result(v8::Isolate *isolate,
+                            v8::Local<v8::Context> context,
+                            NativeCall_t &call);
+v8::Local<v8::Value> to_float(v8::Isolate *isolate,
+                              v8::Local<v8::Context> context,
+                              v8::Local<v8::Value> value);
 } // namespace native
-} // namespace sampnode
\ No newline at end of file
+} // namespace sampnode
@@ -1,11 +1,37 @@
 #include "nodeimpl.hpp"
 
 #include <chrono>
+#include <cstddef>
 #include <cstdlib>
+#include <limits>
+#include <optional>
 #include <thread>
 
+#ifndef _WIN32
+#include <poll.h>
+#endif
+#ifdef __GLIBC__
+#include <malloc.h>
+#endif
+
+#include "affinity.hpp"
 #include "config.hpp"
+#include "errorlog.hpp"
+#include "heapdiag.hpp"
+#include "hibernation.hpp"
+#include "idlegc.hpp"
+#include "pooledallocator.hpp"
+#include "profiler.hpp"
 #include "resource.hpp"
+#include "snapshot.hpp"
+#include "tickstats.hpp"
+#include "trace.hpp"
+#include "watchdog.hpp"
+
+namespace {
+// how long a server tick keeps serving calls of a background load
+constexpr auto kLoaderCallBudget = std::chrono::milliseconds(2);
+} // namespace
 
 void OnMessage(v8::Local<v8::Message> message, v8::Local<v8::Value> error) {
   auto isolate = sampnode::nodeImpl.GetIsolate();
@@ -13,6 +39,14 @@ void OnMessage(v8::Local<v8::Message> message, v8::Local<v8::Value> error) {
   v8::Isolate::Scope isolateScope(isolate);
   v8::HandleScope handleScope(isolate);
 
+  // the same exception thrown over and over is only logged once per window
+  v8::String::Utf8Value msgStr(isolate, message->Get());
+  if (!sampnode::errorlog::admit(
+          "uncaught", *msgStr ? *msgStr : "",
+          sampnode::errorlog::location(isolate, isolate->GetCurrentContext(),
+                                       message)))
+    return;
+
   // Prefer error.stack if available (respects --enable-source-maps)
   if (error->IsObject()) {
     v8::Local<v8::Context> ctx = isolate->GetCurrentContext();
@@ -23,7 +57,6 @@ void OnMessage(v8::Local<v8::Message> message, v8::Local<v8::Value> error) {
                   v8::String::NewFromUtf8(isolate, "stack").ToLocalChecked())
             .ToLocal(&stackVal) &&
         stackVal->IsString()) {
-      v8::String::Utf8Value msgStr(isolate, message->Get());
       v8::String::Utf8Value stackStr(isolate, stackVal);
       L_ERROR << *msgStr << "\n" << *stackStr;
       return;
@@ -31,7 +64,6 @@ void OnMessage(v8::Local<v8::Message> message, v8::Local<v8::Value> error) {
   }
 
   // Fallback: raw V8 stack trace
-  v8::String::Utf8Value messageStr(isolate, message->Get());
   v8::String::Utf8Value errorStr(isolate, error);
 
   std::stringstream stack;
@@ -48,22 +80,74 @@ void OnMessage(v8::Local<v8::Message> message, v8::Local<v8::Value> error) {
     }
   }
 
-  L_ERROR << *messageStr << "\n" << stack.str() << "\n" << *errorStr;
+  L_ERROR << *msgStr << "\n" << stack.str() << "\n" << *errorStr;
 }
 
 namespace sampnode {
 NodeImpl nodeImpl;
 bool NodeImpl::esmLoading;
+bool NodeImpl::jsEntered;
 
 NodeImpl::NodeImpl() : nodeData(nullptr, node::FreeIsolateData) {}
 NodeImpl::~NodeImpl() {}
 
-void NodeImpl::Tick() {
-  v8::Locker locker(v8Isolate);
-  v8::Isolate::Scope isolateScope(v8Isolate);
-  v8::HandleScope hs(v8Isolate);
+// Cheap check whether uv_run would have anything to do, so idle ticks can skip
+// the Locker, scopes and the epoll_wait inside uv_run altogether.
+bool NodeImpl::HasPendingWork() {
+  // JS that ran outside of Tick (events) may have left microtasks or
+  // process.nextTick callbacks behind
+  if (jsEntered)
+    return true;
+
+#ifdef _WIN32
+  return true;
+#else
+  uv_loop_t *loop = nodeLoop->GetLoop();
+  auto queueEmpty = [](const uv__queue *q) { return q->next == q; };
+
+  if (!queueEmpty(&loop->pending_queue) || !queueEmpty(&loop->idle_handles) ||
+      !queueEmpty(&loop->watcher_queue) || loop->closing_handles != nullptr)
+    return true;
+
+  if (loop->timer_heap.min != nullptr) {
+    const uv_timer_t *timer = reinterpret_cast<const uv_timer_t *>(
+        static_cast<const char *>(loop->timer_heap.min) -
+        offsetof(uv_timer_t, node));
+    uv_update_time(loop);
+    if (timer->timeout <= uv_now(loop))
+      return true;
+  }
+
+  // the backend (epoll/kqueue) fd becomes readable once any watched fd,
+  // including the async wakeups used by the threadpool and the platform, fires
+  pollfd pfd{uv_backend_fd(loop), POLLIN, 0};
+  return poll(&pfd, 1, 0) > 0;
+#endif
+}
+
+bool NodeImpl::Tick(uv_run_mode mode) {
+  trace::Span span(trace::Category::Tick, "NodeImpl::Tick");
+  profiler::TimeScope jsTime;
+  auto start = std::chrono::steady_clock::now();
+  bool idle = !resource || (mode == UV_RUN_NOWAIT && !HasPendingWork());
+  uint64_t waitedNs = 0;
+
+  if (!idle) {
+    v8::Locker locker(v8Isolate);
+    v8::Isolate::Scope isolateScope(v8Isolate);
+    v8::HandleScope hs(v8Isolate);
+
+    jsEntered = false;
+
+    std::optional<watchdog::Scope> watchdogScope;
+    watchdogScope.emplace(watchdog::Kind::Tick, "tick");
+    std::optional<watchdog::Scope> *outerScope = tickScope;
+    bool outerBlocking = tickBlocking;
+    uint64_t outerPollNs = pollNs;
+    tickScope = &watchdogScope;
+    tickBlocking = mode != UV_RUN_NOWAIT;
+    pollNs = 0;
 
-  if (resource) {
     v8::Local<v8::Context> ctx = resource->GetContext().Get(v8Isolate);
     v8::Context::Scope contextScope(ctx);
 
@@ -71,11 +155,40 @@ void NodeImpl::Tick() {
                                       resource->GetAsyncResource(v8Isolate),
                                       resource->GetAsyncContext());
 
-    v8Isolate->PerformMicrotaskCheckpoint();
-    uv_run(nodeLoop->GetLoop(), UV_RUN_NOWAIT);
-    v8Isolate->PerformMicrotaskCheckpoint();
-    v8Platform->DrainTasks(v8Isolate);
+    {
+      trace::Span span(trace::Category::Tick, "microtasks");
+      v8Isolate->PerformMicrotaskCheckpoint();
+    }
+    {
+      trace::Span span(trace::Category::Tick, "uv_run");
+      uv_run(nodeLoop->GetLoop(), mode);
+    }
+    {
+      trace::Span span(trace::Category::Tick, "microtasks");
+      v8Isolate->PerformMicrotaskCheckpoint();
+    }
+    {
+      trace::Span span(trace::Category::Tick, "platform tasks");
+      v8Platform->DrainTasks(v8Isolate);
+    }
+
+    waitedNs = pollNs;
+    tickScope = outerScope;
+    tickBlocking = outerBlocking;
+    pollNs = outerPollNs;
   }
+
+  uint64_t elapsedNs = std::chrono::duration_cast<std::chrono::nanoseconds>(
+                          std::chrono::steady_clock::now() - start)
+                          .count();
+  // a blocking tick mostly waits for work, only the rest is tick time
+  elapsedNs -= waitedNs;
+  jsTime.Exclude(waitedNs);
+  tickstats::record(idle, elapsedNs);
+  if (resource)
+    heapdiag::on_tick(v8Isolate, idle);
+  errorlog::on_tick();
+  return !idle;
 }
 
 void NodeImpl::Initialize(const Props_t &config) {
@@ -97,6 +210,16 @@ void NodeImpl::Initialize(const Props_t &config) {
     L_DEBUG << "node flags: " << flag;
   }
 
+  // libuv reads this once, when the threadpool is first used
+  if (config.uv_threadpool_size > 0) {
+    std::string size = std::to_string(config.uv_threadpool_size);
+#ifdef _WIN32
+    _putenv_s("UV_THREADPOOL_SIZE", size.c_str());
+#else
+    setenv("UV_THREADPOOL_SIZE", size.c_str(), 1);
+#endif
+  }
+
   auto result = node::InitializeOncePerProcess(
       args, {node::ProcessInitializationFlags::kNoInitializeV8,
              node::ProcessInitializationFlags::kNoInitializeNodeV8Platform,
@@ -110,14 +233,73 @@ void NodeImpl::Initialize(const Props_t &config) {
     return;
   }
 
-  v8Platform = node::MultiIsolatePlatform::Create(4);
+  v8Platform = node::MultiIsolatePlatform::Create(
+      config.platform_threads > 0 ? config.platform_threads : 4);
   v8::V8::InitializePlatform(v8Platform.get());
   v8::V8::Initialize();
 
-  arrayBufferAllocator = node::ArrayBufferAllocator::Create();
+  LoadSnapshot();
+
   nodeLoop = std::make_unique<UvLoop>("mainNode");
-  v8Isolate = node::NewIsolate(arrayBufferAllocator.get(), nodeLoop->GetLoop(),
-                               v8Platform.get());
+  ApplyThreadLayout();
+
+  uv_loop_t *loop = nodeLoop->GetLoop();
+  uv_prepare_init(loop, &tickPrepare);
+  tickPrepare.data = this;
+  uv_prepare_start(&tickPrepare, [](uv_prepare_t *handle) {
+    NodeImpl *self = static_cast<NodeImpl *>(handle->data);
+    if (self->tickScope != nullptr && self->tickBlocking) {
+      self->tickScope->reset();
+      self->pollStart = std::chrono::steady_clock::now();
+    }
+  });
+  uv_unref(reinterpret_cast<uv_handle_t *>(&tickPrepare));
+  uv_check_init(loop, &tickCheck);
+  tickCheck.data = this;
+  uv_check_start(&tickCheck, [](uv_check_t *handle) {
+    NodeImpl *self = static_cast<NodeImpl *>(handle->data);
+    if (self->tickScope != nullptr && !self->tickScope->has_value()) {
+      self->pollNs += std::chrono::duration_cast<std::chrono::nanoseconds>(
+                          std::chrono::steady_clock::now() - self->pollStart)
+                          .count();
+      self->tickScope->emplace(watchdog::Kind::Tick, "tick");
+    }
+  });
+  uv_unref(reinterpret_cast<uv_handle_t *>(&tickCheck));
+
+  if (config.array_buffer_pool && snapshotData) {
+    L_WARN << "array_buffer_pool is ignored when starting from a snapshot";
+  }
+
+  CreateIsolate();
+  errorlog::init(config);
+}
+
+void NodeImpl::LoadSnapshot() {
+  snapshotData.reset();
+  if (mainConfig.snapshot_blob.empty())
+    return;
+
+  if (!mainConfig.snapshot_builder.empty() &&
+      snapshot::is_stale(mainConfig.snapshot_builder, mainConfig.snapshot_blob))
+    snapshot::build(v8Platform.get(), mainConfig.snapshot_builder,
+                    mainConfig.snapshot_blob);
+  snapshotData = snapshot::load(mainConfig.snapshot_blob);
+}
+
+void NodeImpl::CreateIsolate() {
+  const Props_t &config = mainConfig;
+
+  // with the pool, node's allocator is still handed to the IsolateData, it
+  // holds the zero-fill flag Buffer.allocUnsafe clears
+  arrayBufferAllocator = node::ArrayBufferAllocator::Create();
+  if (config.array_buffer_pool && !snapshotData) {
+    v8Isolate = NewPooledIsolate();
+  } else {
+    v8Isolate = node::NewIsolate(arrayBufferAllocator.get(),
+                                 nodeLoop->GetLoop(), v8Platform.get(),
+                                 snapshotData.get());
+  }
 
   v8::Locker locker(v8Isolate);
   v8::Isolate::Scope isolateScope(v8Isolate);
@@ -126,28 +308,212 @@ void NodeImpl::Initialize(const Props_t &config) {
   v8Isolate->SetFatalErrorHandler(
       [](const char *location, const char *message) {
         L_ERROR << "at " << location << ": " << message;
+        Log::Flush();
         exit(1);
       });
 
   v8Isolate->SetCaptureStackTraceForUncaughtExceptions(true);
   v8Isolate->AddMessageListener(OnMessage);
+  idlegc::install(v8Isolate, v8Platform.get(), config);
+  profiler::install(v8Isolate, config);
+  watchdog::start(v8Isolate, config);
+  heapdiag::install(v8Isolate, config);
+
+  nodeData.reset(node::CreateIsolateData(
+      v8Isolate, nodeLoop->GetLoop(), v8Platform.get(),
+      arrayBufferAllocator.get(), snapshotData.get()));
+}
+
+void NodeImpl::DisposeIsolate() {
+  idlegc::uninstall(v8Isolate);
+  profiler::uninstall(v8Isolate);
+  watchdog::stop();
+  heapdiag::uninstall(v8Isolate);
+
+  // the toggle lives in node's allocator, which goes away with the isolate
+  if (pooledAllocator)
+    pooledAllocator->SetZeroFillToggle(nullptr);
+
+  {
+    v8::Locker locker(v8Isolate);
+    node::FreeIsolateData(nodeData.release());
+  }
+  v8Platform->UnregisterIsolate(v8Isolate);
+  v8Isolate->Dispose();
+  v8Isolate = nullptr;
+  arrayBufferAllocator = nullptr;
+}
+
+v8::Isolate *NodeImpl::NewPooledIsolate() {
+  // kept when a reload replaces the isolate, its cached blocks stay usable
+  if (!pooledAllocator) {
+    pooledAllocator = std::make_unique<PooledAllocator>(
+        static_cast<size_t>(mainConfig.array_buffer_pool_cache_kb) * 1024);
+    hibernation::add_trim_hook([this] {
+      if (pooledAllocator)
+        pooledAllocator->Trim();
+    });
+  }
+
+  // the steps of node::NewIsolate, which only takes node's own allocator
+  v8::Isolate::CreateParams params;
+  params.array_buffer_allocator = pooledAllocator.get();
+
+  uint64_t totalMemory = uv_get_total_memory();
+  uint64_t constrainedMemory = uv_get_constrained_memory();
+  if (constrainedMemory > 0 && constrainedMemory < totalMemory)
+    totalMemory = constrainedMemory;
+  if (totalMemory > 0)
+    params.constraints.ConfigureDefaults(totalMemory, 0);
+
+  // same as node: BaseObject::kSlot holds the C++ object of a wrapper
+  params.embedder_wrapper_object_index = 1;
+  params.embedder_wrapper_type_index = std::numeric_limits<int>::max();
+
+  v8::Isolate *isolate = v8::Isolate::Allocate();
+  v8Platform->RegisterIsolate(isolate, nodeLoop->GetLoop());
+  v8::Isolate::Initialize(isolate, params);
+  node::SetIsolateUpForNode(isolate);
+
+  L_INFO << "ArrayBuffer pool enabled, caching up to "
+         << mainConfig.array_buffer_pool_cache_kb << " KB per size class";
+  return isolate;
+}
 
-  nodeData.reset(node::CreateIsolateData(v8Isolate, nodeLoop->GetLoop(),
-                                         v8Platform.get(),
-                                         arrayBufferAllocator.get()));
+void NodeImpl::ApplyThreadLayout() {
+  int platformThreads = v8Platform->NumberOfWorkerThreads();
+  int platformPinned =
+      affinity::pin_platform_workers(v8Platform.get(), mainConfig.platform_cpus);
+
+  int uvThreads = 4;
+  if (const char *size = std::getenv("UV_THREADPOOL_SIZE")) {
+    uvThreads = std::atoi(size);
+    uvThreads = uvThreads < 1 ? 1 : (uvThreads > 1024 ? 1024 : uvThreads);
+  }
+  int uvPinned = affinity::pin_uv_threadpool(nodeLoop->GetLoop(), uvThreads,
+                                             mainConfig.platform_cpus);
+
+  L_INFO << "platform: " << platformThreads << " worker threads on cpus "
+         << affinity::to_string(mainConfig.platform_cpus) << " ("
+         << platformPinned << " pinned)";
+  L_INFO << "uv threadpool: " << uvThreads << " threads on cpus "
+         << affinity::to_string(mainConfig.platform_cpus) << " (" << uvPinned
+         << " pinned)";
+
+  if (!mainConfig.platform_cpus.empty() &&
+      (platformPinned < platformThreads || uvPinned < uvThreads))
+    L_WARN << "not every pool thread could be pinned to cpus "
+           << affinity::to_string(mainConfig.platform_cpus);
 }
+
 bool NodeImpl::LoadResource() {
+  auto start = std::chrono::steady_clock::now();
+
+  // keeps the loop alive while the import only waits on promises, and lets
+  // NotifyLoaded end the blocking uv_run right away
+  uv_loop_t *loop = nodeLoop->GetLoop();
+  uv_async_init(loop, &loadedSignal, [](uv_async_t *) {});
+
   resource = std::make_shared<Resource>();
   resource->Init();
 
-  while (esmLoading) {
-    Tick();
-    std::this_thread::sleep_for(std::chrono::milliseconds(1));
-  }
+  while (esmLoading)
+    Tick(UV_RUN_ONCE);
+
+  uv_close(reinterpret_cast<uv_handle_t *>(&loadedSignal), nullptr);
+
+  L_INFO << "entry file loaded in "
+         << std::chrono::duration_cast<std::chrono::milliseconds>(
+                std::chrono::steady_clock::now() - start)
+                .count()
+         << "ms";
 
   return true;
 }
 
+void NodeImpl::NotifyLoaded() {
+  esmLoading = false;
+  uv_async_send(&loadedSignal);
+}
+
+void NodeImpl::LoadInBackground(const Props_t &config) {
+  backgroundLoading = true;
+  loaderDone = false;
+
+  loader = std::thread([this, config] {
+    trace::set_thread_name("loader");
+    Initialize(config);
+    LoadResource();
+    {
+      std::lock_guard<std::mutex> lock(loaderMutex);
+      loaderDone = true;
+    }
+    loaderCv.notify_all();
+  });
+
+  L_INFO << "loading the JS runtime in the background";
+}
+
+void NodeImpl::ProcessBackgroundLoad() {
+  {
+    // The import often calls natives back to back. Each one only continues
+    // once it was served, so keep serving for a while instead of one per tick.
+    auto deadline = std::chrono::steady_clock::now() + kLoaderCallBudget;
+    auto callPending = [this] {
+      return loaderCall != nullptr && !loaderCallDone;
+    };
+
+    std::unique_lock<std::mutex> lock(loaderMutex);
+    while (callPending()) {
+      const std::function<void()> *call = loaderCall;
+      lock.unlock();
+      (*call)();
+      lock.lock();
+      loaderCallDone = true;
+      loaderCv.notify_all();
+
+      if (!loaderCv.wait_until(lock, deadline, [&] {
+            return callPending() || loaderDone;
+          }))
+        break;
+    }
+  }
+
+  if (!loaderDone)
+    return;
+
+  loader.join();
+  backgroundLoading = false;
+
+  L_INFO << "JS runtime is ready, replaying " << queuedEvents.size()
+         << " queued events";
+
+  std::vector<QueuedEvent_t> events;
+  events.swap(queuedEvents);
+  for (auto &queued : events)
+    queued.target->call(queued.args, nullptr, queued.isFromPawnNative);
+}
+
+void NodeImpl::QueueEvent(event *_event, AMX *amx, cell *params,
+                          bool isFromPawnNative) {
+  QueuedEvent_t queued{_event, {}, isFromPawnNative};
+  if (!_event->collect_args(amx, params, isFromPawnNative, queued.args)) {
+    L_ERROR << "Failed to convert AMX parameters to V8 values: "
+            << _event->get_name();
+    return;
+  }
+  queuedEvents.push_back(std::move(queued));
+}
+
+void NodeImpl::RunFromLoader(const std::function<void()> &fn) {
+  std::unique_lock<std::mutex> lock(loaderMutex);
+  loaderCall = &fn;
+  loaderCallDone = false;
+  loaderCv.notify_all();
+  loaderCv.wait(lock, [this] { return loaderCallDone; });
+  loaderCall = nullptr;
+}
+
 bool NodeImpl::UnloadResource() {
   if (!resource)
     return false;
@@ -155,19 +521,113 @@ bool NodeImpl::UnloadResource() {
   return true;
 }
 
-bool NodeImpl::ReloadResource() { return UnloadResource() && LoadResource(); }
+// Swaps the Environment and its context for fresh ones. The isolate, the
+// platform and the compile cache stay, so the new bundle starts warm. Only the
+// first Environment of an isolate can use its snapshot, so with snapshot_blob
+// the isolate is replaced too, from the blob rebuilt if the builder changed.
+bool NodeImpl::ReloadResource() {
+  if (!resource || backgroundLoading) {
+    L_WARN << "no resource is loaded, nothing to reload";
+    return false;
+  }
+
+  bool snapshotMode = !mainConfig.snapshot_blob.empty();
+  L_INFO << "reloading "
+         << (snapshotMode ? mainConfig.snapshot_blob : mainConfig.entry_file);
+  auto start = std::chrono::steady_clock::now();
+  size_t heapBefore = UsedHeapSize();
+
+  {
+    v8::Locker locker(v8Isolate);
+    v8::Isolate::Scope isolateScope(v8Isolate);
+    // listeners hold functions of the old context and would keep it alive
+    event::clear_listeners();
+  }
+  UnloadResource();
+
+  if (snapshotMode) {
+    // falls back to entry_file like at startup when the blob can't be used
+    DisposeIsolate();
+    LoadSnapshot();
+    CreateIsolate();
+  } else {
+    v8::Locker locker(v8Isolate);
+    v8::Isolate::Scope isolateScope(v8Isolate);
+    v8Isolate->LowMemoryNotification();
+  }
+  size_t heapAfter = UsedHeapSize();
+  auto unloaded = std::chrono::steady_clock::now();
+
+  esmLoading = true;
+  LoadResource();
+
+  auto ms = [](std::chrono::steady_clock::duration duration) {
+    return std::chrono::duration_cast<std::chrono::milliseconds>(duration)
+        .count();
+  };
+  auto end = std::chrono::steady_clock::now();
+  L_INFO << "resource reloaded in " << ms(end - start) << "ms (unload "
+         << ms(unloaded - start) << "ms, load " << ms(end - unloaded)
+         << "ms), reclaimed "
+         << (heapBefore > heapAfter ? (heapBefore - heapAfter) / 1024 : 0)
+         << " KB of " << heapBefore / 1024 << " KB heap";
+  return true;
+}
+
+void NodeImpl::SetHibernating(bool hibernating) {
+  if (v8Isolate == nullptr || backgroundLoading)
+    return;
+
+  v8::Locker locker(v8Isolate);
+  v8::Isolate::Scope isolateScope(v8Isolate);
+
+  if (!hibernating) {
+    v8Isolate->IsolateInForegroundNotification();
+    L_INFO << "player connected, leaving hibernation";
+    return;
+  }
+
+  size_t heapBefore = UsedHeapSize();
+
+  // optimizes the heap for size, which also keeps the young generation small
+  v8Isolate->IsolateInBackgroundNotification();
+  v8Isolate->LowMemoryNotification();
+  hibernation::run_trim_hooks();
+#ifdef __GLIBC__
+  malloc_trim(0);
+#endif
+
+  L_INFO << "no players online, hibernating (heap " << heapBefore / 1024
+         << " KB -> " << UsedHeapSize() / 1024 << " KB)";
+}
+
+size_t NodeImpl::UsedHeapSize() {
+  v8::Locker locker(v8Isolate);
+  v8::HeapStatistics heap;
+  v8Isolate->GetHeapStatistics(&heap);
+  return heap.used_heap_size();
+}
 
 void NodeImpl::Stop() {
+  // the loader may be blocked on a native call that only we can serve
+  while (backgroundLoading) {
+    ProcessBackgroundLoad();
+    if (backgroundLoading)
+      std::this_thread::sleep_for(std::chrono::milliseconds(1));
+  }
+
   esmLoading = false;
+  tickstats::log_summary();
   UnloadResource();
 
-  v8Isolate->Dispose();
-  v8Isolate = nullptr;
+  errorlog::shutdown();
+  DisposeIsolate();
 
-  arrayBufferAllocator = nullptr;
+  pooledAllocator = nullptr;
+  uv_close(reinterpret_cast<uv_handle_t *>(&tickPrepare), nullptr);
+  uv_close(reinterpret_cast<uv_handle_t *>(&tickCheck), nullptr);
   nodeLoop = nullptr;
-
-  node::FreeIsolateData(nodeData.release());
+  snapshotData.reset();
   node::FreePlatform(v8Platform.release());
 
   v8::V8::Dispose();
@@ -1,19 +1,31 @@
 #pragma once
 
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <functional>
 #include <memory>
+#include <mutex>
+#include <optional>
+#include <thread>
+#include <vector>
 
 #include "config.hpp"
+#include "events.hpp"
 #include "node.h"
+#include "pooledallocator.hpp"
 #include "resource.hpp"
 #include "uv.h"
 #include "uvloop.hpp"
 #include "v8.h"
+#include "watchdog.hpp"
 
 namespace sampnode {
 
 class NodeImpl {
 public:
   static bool esmLoading;
+  static bool jsEntered;
 
   NodeImpl();
   ~NodeImpl();
@@ -27,19 +39,98 @@ public:
   v8::Isolate *GetIsolate() noexcept { return v8Isolate; }
   node::IsolateData *GetNodeIsolate() noexcept { return nodeData.get(); }
   UvLoop *GetUVLoop() noexcept { return nodeLoop.get(); }
+  bool IsFromSnapshot() const noexcept { return snapshotData != nullptr; }
+  // null unless array_buffer_pool is enabled
+  PooledAllocator *GetPooledAllocator() noexcept {
+    return pooledAllocator.get();
+  }
   Props_t &GetMainConfig() noexcept { return mainConfig; }
 
-  void Tick();
+  // false when there was nothing to do and the loop was skipped
+  bool Tick(uv_run_mode mode = UV_RUN_NOWAIT);
   void Stop();
 
+  // Reload is requested from RCON or Pawn and performed on the thread that
+  // owns the isolate, outside of any JS call.
+  void RequestReload() noexcept { reloadRequested = true; }
+  bool TakeReloadRequest() noexcept { return reloadRequested.exchange(false); }
+
+  // compacts the heap and gives pooled memory back while no one is online
+  void SetHibernating(bool hibernating);
+
+  // called by the bootstrap once the entry file has been imported
+  void NotifyLoaded();
+
+  // Runs Initialize and LoadResource on a helper thread, so they overlap with
+  // the server loading other plugins and the gamemode. Until the handover in
+  // ProcessBackgroundLoad, events are queued and natives called by the
+  // loading JS are executed on the server thread.
+  void LoadInBackground(const Props_t &config);
+  bool IsLoadingInBackground() const noexcept { return backgroundLoading; }
+  void ProcessBackgroundLoad();
+  void QueueEvent(event *_event, AMX *amx, cell *params,
+                  bool isFromPawnNative);
+
+  // fn touches the server (natives, publics) and must run on its thread
+  template <typename F> void RunOnServerThread(F &&fn) {
+    if (backgroundLoading)
+      RunFromLoader(std::function<void()>(std::forward<F>(fn)));
+    else
+      fn();
+  }
+
 private:
+  struct QueuedEvent_t {
+    event *target;
+    std::vector<event::EventArg_t> args;
+    bool isFromPawnNative;
+  };
+
+  bool HasPendingWork();
+  size_t UsedHeapSize();
+  void RunFromLoader(const std::function<void()> &fn);
+  void ApplyThreadLayout();
+  // builds snapshot_blob when the builder is newer, then loads it
+  void LoadSnapshot();
+  // the isolate, its hooks and IsolateData, from snapshotData if there is one
+  void CreateIsolate();
+  void DisposeIsolate();
+  v8::Isolate *NewPooledIsolate();
+
   v8::Isolate *v8Isolate;
   std::unique_ptr<node::IsolateData, decltype(&node::FreeIsolateData)> nodeData;
   std::unique_ptr<node::MultiIsolatePlatform> v8Platform;
   std::unique_ptr<node::ArrayBufferAllocator> arrayBufferAllocator;
+  std::unique_ptr<PooledAllocator> pooledAllocator;
   std::unique_ptr<UvLoop> nodeLoop;
+  // must outlive the isolate that was deserialized from it
+  node::EmbedderSnapshotData::Pointer snapshotData;
   std::shared_ptr<Resource> resource;
   Props_t mainConfig;
+
+  std::atomic<bool> reloadRequested{false};
+
+  // wakes a blocking uv_run while the entry file is being imported
+  uv_async_t loadedSignal;
+
+  // Disarm the watchdog scope of a blocking Tick before the loop waits in
+  // poll and arm it again after, so only its callbacks count as JS time.
+  // The wait itself is summed into pollNs and left out of the tick stats.
+  uv_prepare_t tickPrepare;
+  uv_check_t tickCheck;
+  std::optional<watchdog::Scope> *tickScope = nullptr;
+  bool tickBlocking = false;
+  std::chrono::steady_clock::time_point pollStart;
+  uint64_t pollNs = 0;
+
+  std::thread loader;
+  std::atomic<bool> backgroundLoading{false};
+  std::atomic<bool> loaderDone{false};
+  std::mutex loaderMutex;
+  std::condition_variable loaderCv;
+  const std::function<void()> *loaderCall = nullptr;
+  bool loaderCallDone = false;
+  std::vector<QueuedEvent_t> queuedEvents;
 };
 
 extern NodeImpl nodeImpl;
@@ -0,0 +1,340 @@
+#include "perfstats.hpp"
+
+#include <condition_variable>
+#include <cstring>
+#include <memory>
+#include <mutex>
+#include <sstream>
+#include <thread>
+#include <unordered_map>
+
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <unistd.h>
+#endif
+
+namespace sampnode {
+namespace perfstats {
+bool enabled = false;
+
+namespace {
+using CounterMap = std::unordered_map<std::string, std::unique_ptr<Counter_t>>;
+
+// insertions are locked against the exporter, lookups by the single writer
+// thread are not
+std::mutex countersMutex;
+CounterMap natives;
+CounterMap events;
+CounterMap listeners;
+
+// Layout of the stats file, followed by the JSON document. sequence is odd
+// while the document is being rewritten, readers retry until it is even and
+// unchanged across their copy.
+struct FileHeader_t {
+  char magic[8];
+  uint32_t version;
+  uint32_t headerSize;
+  std::atomic<uint64_t> sequence;
+  uint64_t length;
+  uint64_t timestampMs;
+};
+constexpr size_t kHeaderSize = 64;
+static_assert(sizeof(FileHeader_t) <= kHeaderSize, "stats header too large");
+
+std::thread exporter;
+std::mutex exporterMutex;
+std::condition_variable exporterCv;
+bool exporterRunning = false;
+
+char *mapped = nullptr;
+size_t mappedSize = 0;
+#ifdef _WIN32
+HANDLE fileHandle = INVALID_HANDLE_VALUE;
+HANDLE mappingHandle = nullptr;
+#else
+int fileFd = -1;
+#endif
+
+void bump(std::atomic<uint64_t> &value, uint64_t amount) {
+  value.store(value.load(std::memory_order_relaxed) + amount,
+              std::memory_order_relaxed);
+}
+
+uint64_t read(const std::atomic<uint64_t> &value) {
+  return value.load(std::memory_order_relaxed);
+}
+
+Counter_t *find_or_add(CounterMap &map, const std::string &name) {
+  auto iter = map.find(name);
+  if (iter != map.end())
+    return iter->second.get();
+
+  std::lock_guard<std::mutex> lock(countersMutex);
+  auto &counter = map[name];
+  counter.reset(new Counter_t());
+  return counter.get();
+}
+
+// upper bound of the bucket holding the given fraction of all calls
+uint64_t percentile_us(const Counter_t &counter, uint64_t count,
+                       double fraction) {
+  uint64_t target = static_cast<uint64_t>(count * fraction);
+  uint64_t seen = 0;
+  for (int i = 0; i < kBuckets; i++) {
+    seen += read(counter.histogram[i]);
+    if (seen > target)
+      return uint64_t(1) << i;
+  }
+  return uint64_t(1) << (kBuckets - 1);
+}
+
+json to_json(const CounterMap &map, const char *countKey,
+             const char *timeKey, const char *extraKey) {
+  json result = json::object();
+  for (auto &entry : map) {
+    const Counter_t &counter = *entry.second;
+    uint64_t count = read(counter.count);
+    if (count == 0)
+      continue;
+
+    json histogram = json::array();
+    for (int i = 0; i < kBuckets; i++)
+      histogram.push_back(read(counter.histogram[i]));
+
+    json item = {{countKey, count},
+                 {timeKey, read(counter.timeNs) / 1e6},
+                 {"maxMs", read(counter.maxNs) / 1e6},
+                 {"p50Us", percentile_us(counter, count, 0.5)},
+                 {"p99Us", percentile_us(counter, count, 0.99)},
+                 {"histogram", histogram}};
+    if (extraKey != nullptr)
+      item[extraKey] = read(counter.extraNs) / 1e6;
+    result[entry.first] = item;
+  }
+  return result;
+}
+
+json snapshot() {
+  std::lock_guard<std::mutex> lock(countersMutex);
+  return {{"natives", to_json(natives, "calls", "timeMs", "marshalMs")},
+          {"events", to_json(events, "dispatches", "jsMs", "conversionMs")},
+          {"listeners", to_json(listeners, "calls", "timeMs", nullptr)}};
+}
+
+void reset(CounterMap &map) {
+  for (auto &entry : map) {
+    Counter_t &counter = *entry.second;
+    counter.count.store(0, std::memory_order_relaxed);
+    counter.timeNs.store(0, std::memory_order_relaxed);
+    counter.extraNs.store(0, std::memory_order_relaxed);
+    counter.maxNs.store(0, std::memory_order_relaxed);
+    for (auto &bucket : counter.histogram)
+      bucket.store(0, std::memory_order_relaxed);
+  }
+}
+
+bool map_file(const std::string &path, size_t size) {
+#ifdef _WIN32
+  fileHandle = CreateFileA(path.c_str(), GENERIC_READ | GENERIC_WRITE,
+                           FILE_SHARE_READ | FILE_SHARE_WRITE, nullptr,
+                           OPEN_ALWAYS, FILE_ATTRIBUTE_NORMAL, nullptr);
+  if (fileHandle == INVALID_HANDLE_VALUE)
+    return false;
+
+  mappingHandle = CreateFileMappingA(fileHandle, nullptr, PAGE_READWRITE, 0,
+                                     static_cast<DWORD>(size), nullptr);
+  if (mappingHandle != nullptr)
+    mapped = static_cast<char *>(
+        MapViewOfFile(mappingHandle, FILE_MAP_ALL_ACCESS, 0, 0, size));
+  if (mapped == nullptr) {
+    if (mappingHandle != nullptr)
+      CloseHandle(mappingHandle);
+    CloseHandle(fileHandle);
+    mappingHandle = nullptr;
+    fileHandle = INVALID_HANDLE_VALUE;
+    return false;
+  }
+#else
+  fileFd = open(path.c_str(), O_RDWR | O_CREAT, 0644);
+  if (fileFd < 0)
+    return false;
+
+  void *memory = MAP_FAILED;
+  if (ftruncate(fileFd, static_cast<off_t>(size)) == 0)
+    memory = mmap(nullptr, size, PROT_READ | PROT_WRITE, MAP_SHARED, fileFd, 0);
+  if (memory == MAP_FAILED) {
+    close(fileFd);
+    fileFd = -1;
+    return false;
+  }
+  mapped = static_cast<char *>(memory);
+#endif
+
+  mappedSize = size;
+  std::memset(mapped, 0, kHeaderSize);
+  FileHeader_t *header = reinterpret_cast<FileHeader_t *>(mapped);
+  std::memcpy(header->magic, "SNSTATS", 8);
+  header->version = 1;
+  header->headerSize = kHeaderSize;
+  return true;
+}
+
+void unmap_file() {
+  if (mapped == nullptr)
+    return;
+#ifdef _WIN32
+  UnmapViewOfFile(mapped);
+  CloseHandle(mappingHandle);
+  CloseHandle(fileHandle);
+  mappingHandle = nullptr;
+  fileHandle = INVALID_HANDLE_VALUE;
+#else
+  munmap(mapped, mappedSize);
+  close(fileFd);
+  fileFd = -1;
+#endif
+  mapped = nullptr;
+  mappedSize = 0;
+}
+
+void export_stats(bool &warned) {
+  std::string document = snapshot().dump();
+  FileHeader_t *header = reinterpret_cast<FileHeader_t *>(mapped);
+
+  if (document.size() > mappedSize - kHeaderSize) {
+    if (!warned)
+      L_WARN << "perf stats need " << document.size() / 1024 + 1
+             << " KB, more than perf_stats_file_kb allows";
+    warned = true;
+    document = "{}";
+  }
+
+  uint64_t sequence = header->sequence.load(std::memory_order_relaxed);
+  header->sequence.store(sequence + 1, std::memory_order_relaxed);
+  std::atomic_thread_fence(std::memory_order_release);
+
+  std::memcpy(mapped + kHeaderSize, document.data(), document.size());
+  header->length = document.size();
+  header->timestampMs =
+      std::chrono::duration_cast<std::chrono::milliseconds>(
+          std::chrono::system_clock::now().time_since_epoch())
+          .count();
+
+  header->sequence.store(sequence + 2, std::memory_order_release);
+}
+
+void run_exporter(std::chrono::milliseconds interval) {
+  bool warned = false;
+  std::unique_lock<std::mutex> lock(exporterMutex);
+  while (exporterRunning) {
+    exporterCv.wait_for(lock, interval);
+    export_stats(warned);
+  }
+}
+} // namespace
+
+void Counter_t::record(uint64_t ns, uint64_t extra) {
+  uint64_t total = ns + extra;
+  bump(count, 1);
+  bump(timeNs, ns);
+  if (extra != 0)
+    bump(extraNs, extra);
+  if (total > read(maxNs))
+    maxNs.store(total, std::memory_order_relaxed);
+
+  uint64_t us = total / 1000;
+  int bucket = 0;
+  while (us != 0 && bucket < kBuckets - 1) {
+    us >>= 1;
+    bucket++;
+  }
+  bump(histogram[bucket], 1);
+}
+
+void Counter_t::add_extra(uint64_t extra) { bump(extraNs, extra); }
+
+Counter_t *native_counter(const std::string &name) {
+  return find_or_add(natives, name);
+}
+
+Counter_t *event_counter(const std::string &name) {
+  return find_or_add(events, name);
+}
+
+Counter_t *listener_counter(v8::Isolate *isolate,
+                            v8::Local<v8::Function> function) {
+  v8::HandleScope scope(isolate);
+
+  v8::String::Utf8Value name(isolate, function->GetDebugName());
+  v8::String::Utf8Value script(isolate,
+                               function->GetScriptOrigin().ResourceName());
+
+  // 0-based positions, shown like stack traces do
+  std::ostringstream label;
+  label << (name.length() > 0 ? *name : "<anonymous>") << " ("
+        << (script.length() > 0 ? *script : "<unknown>") << ":"
+        << function->GetScriptLineNumber() + 1 << ":"
+        << function->GetScriptColumnNumber() + 1 << ")";
+  return find_or_add(listeners, label.str());
+}
+
+void init(const Props_t &config) {
+  enabled = config.perf_stats;
+  if (!enabled || config.perf_stats_file.empty())
+    return;
+
+  size_t size = static_cast<size_t>(config.perf_stats_file_kb) * 1024;
+  if (size <= kHeaderSize || !map_file(config.perf_stats_file, size)) {
+    L_ERROR << "Unable to map perf stats file " << config.perf_stats_file;
+    return;
+  }
+
+  exporterRunning = true;
+  exporter = std::thread(run_exporter, std::chrono::milliseconds(
+                                           config.perf_stats_interval_ms > 0
+                                               ? config.perf_stats_interval_ms
+                                               : 1000));
+  L_INFO << "exporting perf stats to " << config.perf_stats_file;
+}
+
+void shutdown() {
+  if (exporter.joinable()) {
+    {
+      std::lock_guard<std::mutex> lock(exporterMutex);
+      exporterRunning = false;
+    }
+    exporterCv.notify_all();
+    exporter.join();
+  }
+  unmap_file();
+}
+
+void get(const v8::FunctionCallbackInfo<v8::Value> &info) {
+  v8::Isolate *isolate = info.GetIsolate();
+  v8::HandleScope scope(isolate);
+  v8::Local<v8::Context> context = isolate->GetCurrentContext();
+
+  if (!enabled) {
+    info.GetReturnValue().SetNull();
+    return;
+  }
+
+  std::string document = snapshot().dump();
+  v8::Local<v8::Value> result;
+  if (v8::JSON::Parse(context, v8::String::NewFromUtf8(isolate,
+                                                       document.c_str())
+                                   .ToLocalChecked())
+          .ToLocal(&result))
+    info.GetReturnValue().Set(result);
+
+  if (info.Length() > 0 && info[0]->IsTrue()) {
+    reset(natives);
+    reset(events);
+    reset(listeners);
+  }
+}
+} // namespace perfstats
+} // namespace sampnode
@@ -0,0 +1,54 @@
+#pragma once
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <string>
+
+#include "config.hpp"
+#include "node.h"
+#include "v8.h"
+
+namespace sampnode {
+namespace perfstats {
+// bucket i counts calls shorter than 2^i microseconds, the last one the rest
+constexpr int kBuckets = 21;
+
+// Written only by the thread running JS, read by the exporter and getStats,
+// so plain relaxed stores are enough and the hot path takes no lock.
+struct Counter_t {
+  std::atomic<uint64_t> count{0};
+  // inside the native or the JS listeners
+  std::atomic<uint64_t> timeNs{0};
+  // marshaling for natives, argument conversion for events
+  std::atomic<uint64_t> extraNs{0};
+  // max and histogram are of the whole call, both parts together
+  std::atomic<uint64_t> maxNs{0};
+  std::atomic<uint64_t> histogram[kBuckets]{};
+
+  void record(uint64_t ns, uint64_t extra = 0);
+  void add_extra(uint64_t extra);
+};
+
+extern bool enabled;
+
+inline uint64_t now_ns() {
+  return std::chrono::duration_cast<std::chrono::nanoseconds>(
+             std::chrono::steady_clock::now().time_since_epoch())
+      .count();
+}
+
+// Counters are never removed, so the pointers can be kept by natives,
+// events and listeners for the lifetime of the plugin.
+Counter_t *native_counter(const std::string &name);
+Counter_t *event_counter(const std::string &name);
+// function name and script location, like "onCommand (dist/cmds.js:12:3)"
+Counter_t *listener_counter(v8::Isolate *isolate,
+                            v8::Local<v8::Function> function);
+
+// starts the exporter for perf_stats_file
+void init(const Props_t &config);
+void shutdown();
+
+void get(const v8::FunctionCallbackInfo<v8::Value> &info);
+} // namespace perfstats
+} // namespace sampnode
@@ -0,0 +1,221 @@
+#include "playermirror.hpp"
+
+#include <atomic>
+#include <cstddef>
+#include <cstring>
+#include <memory>
+
+#include "natives.hpp"
+#include "sampgdk.h"
+
+namespace sampnode {
+namespace playermirror {
+namespace {
+constexpr int kSlots = 1000; // MAX_PLAYERS
+constexpr int kNameSize = 25; // MAX_PLAYER_NAME + 1
+constexpr int32_t kVersion = 1;
+
+// Laid out as the JS side sees it, one block per field. seq is odd while a
+// slot is being written, a reader on another thread retries when it saw an
+// odd or changed value.
+struct Mirror_t {
+  int32_t version;
+  int32_t slots;
+  int32_t nameSize;
+  int32_t connectedCount;
+  uint32_t connected[(kSlots + 31) / 32];
+  int32_t seq[kSlots];
+  int32_t state[kSlots];
+  int32_t interior[kSlots];
+  int32_t virtualWorld[kSlots];
+  float x[kSlots];
+  float y[kSlots];
+  float z[kSlots];
+  char name[kSlots][kNameSize];
+};
+
+bool enabled = false;
+// a callback can reach OnPublicCall once per loaded script, only the calls
+// for the first script seen are followed, until it is unloaded
+AMX *sourceAmx = nullptr;
+Mirror_t mirror{};
+std::shared_ptr<v8::BackingStore> store;
+
+AMX_NATIVE getPos = nullptr;
+AMX_NATIVE getState = nullptr;
+AMX_NATIVE getInterior = nullptr;
+AMX_NATIVE getVirtualWorld = nullptr;
+AMX_NATIVE getName = nullptr;
+bool resolved = false;
+
+void resolve() {
+  if (resolved)
+    return;
+  getPos = native::get_address("GetPlayerPos");
+  getState = native::get_address("GetPlayerState");
+  getInterior = native::get_address("GetPlayerInterior");
+  getVirtualWorld = native::get_address("GetPlayerVirtualWorld");
+  getName = native::get_address("GetPlayerName");
+  resolved = true;
+}
+
+// keeps the slot's seq odd while fn writes to it
+template <typename F> void write(int id, F &&fn) {
+  mirror.seq[id]++;
+  std::atomic_thread_fence(std::memory_order_release);
+  fn();
+  std::atomic_thread_fence(std::memory_order_release);
+  mirror.seq[id]++;
+}
+
+void read_position(cell &id) {
+  cell values[3];
+  void *args[] = {&id, &values[0], &values[1], &values[2]};
+  if (getPos) {
+    sampgdk::InvokeNativeArray(getPos, "iRRR", args);
+    mirror.x[id] = amx_ctof(values[0]);
+    mirror.y[id] = amx_ctof(values[1]);
+    mirror.z[id] = amx_ctof(values[2]);
+  }
+  if (getVirtualWorld)
+    mirror.virtualWorld[id] =
+        sampgdk::InvokeNativeArray(getVirtualWorld, "i", args);
+}
+
+void read_all(cell &id) {
+  void *args[] = {&id};
+  read_position(id);
+  if (getState)
+    mirror.state[id] = sampgdk::InvokeNativeArray(getState, "i", args);
+  if (getInterior)
+    mirror.interior[id] = sampgdk::InvokeNativeArray(getInterior, "i", args);
+  if (getName) {
+    cell size = kNameSize;
+    void *nameArgs[] = {&id, mirror.name[id], &size};
+    sampgdk::InvokeNativeArray(getName, "iS[25]i", nameArgs);
+    mirror.name[id][kNameSize - 1] = '\0';
+  }
+}
+
+void clear(int id) {
+  mirror.state[id] = 0;
+  mirror.interior[id] = 0;
+  mirror.virtualWorld[id] = 0;
+  mirror.x[id] = mirror.y[id] = mirror.z[id] = 0.0f;
+  std::memset(mirror.name[id], 0, kNameSize);
+}
+
+bool is_connected(int id) {
+  return (mirror.connected[id / 32] & (1u << (id % 32))) != 0;
+}
+
+void set_connected(int id, bool connected) {
+  if (is_connected(id) == connected)
+    return;
+
+  uint32_t bit = 1u << (id % 32);
+  if (connected)
+    mirror.connected[id / 32] |= bit;
+  else
+    mirror.connected[id / 32] &= ~bit;
+  mirror.connectedCount += connected ? 1 : -1;
+}
+} // namespace
+
+void init(const Props_t &config) {
+  enabled = config.player_mirror;
+  if (!enabled)
+    return;
+
+  mirror.version = kVersion;
+  mirror.slots = kSlots;
+  mirror.nameSize = kNameSize;
+  store = v8::SharedArrayBuffer::NewBackingStore(
+      &mirror, sizeof(mirror), v8::BackingStore::EmptyDeleter, nullptr);
+}
+
+void on_public_call(AMX *amx, const char *name, cell *params) {
+  if (!enabled || std::strncmp(name, "OnPlayer", 8) != 0)
+    return;
+
+  if (sourceAmx == nullptr)
+    sourceAmx = amx;
+  else if (amx != sourceAmx)
+    return;
+
+  cell id = params[1];
+  if (id < 0 || id >= kSlots)
+    return;
+  const char *event = name + 8;
+
+  // the most frequent one first, it only refreshes what has no callback
+  if (std::strcmp(event, "Update") == 0) {
+    resolve();
+    if (is_connected(id)) {
+      write(id, [&] { read_position(id); });
+    } else {
+      // connected before the plugin was loaded
+      write(id, [&] {
+        read_all(id);
+        set_connected(id, true);
+      });
+    }
+  } else if (std::strcmp(event, "StateChange") == 0) {
+    write(id, [&] { mirror.state[id] = params[2]; });
+  } else if (std::strcmp(event, "InteriorChange") == 0) {
+    write(id, [&] { mirror.interior[id] = params[2]; });
+  } else if (std::strcmp(event, "Connect") == 0 ||
+             std::strcmp(event, "Spawn") == 0) {
+    // a spawn also picks up names and worlds set by scripts
+    resolve();
+    write(id, [&] {
+      read_all(id);
+      set_connected(id, true);
+    });
+  } else if (std::strcmp(event, "Disconnect") == 0) {
+    write(id, [&] {
+      set_connected(id, false);
+      clear(id);
+    });
+  }
+}
+
+void on_amx_unload(AMX *amx) {
+  if (amx == sourceAmx)
+    sourceAmx = nullptr;
+}
+
+void get(v8::Local<v8::Name> property,
+         const v8::PropertyCallbackInfo<v8::Value> &info) {
+  v8::Isolate *isolate = info.GetIsolate();
+  if (!store) {
+    info.GetReturnValue().SetNull();
+    return;
+  }
+  info.GetReturnValue().Set(v8::SharedArrayBuffer::New(isolate, store));
+}
+
+v8::Local<v8::ObjectTemplate> layout(v8::Isolate *isolate) {
+  v8::Local<v8::ObjectTemplate> object = v8::ObjectTemplate::New(isolate);
+  auto set = [&](const char *key, size_t value) {
+    object->Set(v8::String::NewFromUtf8(isolate, key).ToLocalChecked(),
+                v8::Integer::NewFromUnsigned(isolate,
+                                             static_cast<uint32_t>(value)));
+  };
+
+  set("slots", kSlots);
+  set("nameSize", kNameSize);
+  set("connectedCount", offsetof(Mirror_t, connectedCount));
+  set("connected", offsetof(Mirror_t, connected));
+  set("seq", offsetof(Mirror_t, seq));
+  set("state", offsetof(Mirror_t, state));
+  set("interior", offsetof(Mirror_t, interior));
+  set("virtualWorld", offsetof(Mirror_t, virtualWorld));
+  set("x", offsetof(Mirror_t, x));
+  set("y", offsetof(Mirror_t, y));
+  set("z", offsetof(Mirror_t, z));
+  set("name", offsetof(Mirror_t, name));
+  return object;
+}
+} // namespace playermirror
+} // namespace sampnode
@@ -0,0 +1,28 @@
+#pragma once
+
+#include "amx/amx.h"
+#include "config.hpp"
+#include "node.h"
+#include "v8.h"
+
+namespace sampnode {
+namespace playermirror {
+// With player_mirror, the plugin keeps who is connected, their state,
+// interior, virtual world, position and name in a block of memory that JS
+// sees as samp.playerMirror, a SharedArrayBuffer. It is updated from the
+// player callbacks the server sends through OnPublicCall, so reading it
+// needs no native call.
+void init(const Props_t &config);
+
+// server thread, before the event is handed to JS
+void on_public_call(AMX *amx, const char *name, cell *params);
+// lets the mirror follow another script once the one it follows is gone
+void on_amx_unload(AMX *amx);
+
+// getter of samp.playerMirror, null when the mirror is off
+void get(v8::Local<v8::Name> property,
+         const v8::PropertyCallbackInfo<v8::Value> &info);
+// samp.playerMirrorLayout, the byte offsets of the blocks in the buffer
+v8::Local<v8::ObjectTemplate> layout(v8::Isolate *isolate);
+} // namespace playermirror
+} // namespace sampnode
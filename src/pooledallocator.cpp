@@ -0,0 +1,146 @@
+#include "pooledallocator.hpp"
+
+#include <cstdlib>
+#include <cstring>
+
+namespace sampnode {
+PooledAllocator::PooledAllocator(size_t maxCachedBytesPerClass)
+    : maxCachedBytes(maxCachedBytesPerClass) {
+  for (size_t i = 0; i < kClassCount; i++)
+    classes[i].stats.size = kMinClassSize << i;
+}
+
+PooledAllocator::~PooledAllocator() { Trim(); }
+
+int PooledAllocator::ClassIndex(size_t length) {
+  size_t size = kMinClassSize;
+  for (size_t i = 0; i < kClassCount; i++, size <<= 1) {
+    if (length <= size)
+      return static_cast<int>(i);
+  }
+  return -1;
+}
+
+void *PooledAllocator::Allocate(size_t length) {
+  // only read on the JS thread, which is also the one toggling it
+  const uint32_t *toggle = zeroFillToggle.load(std::memory_order_relaxed);
+  return AllocateFrom(length, toggle == nullptr || *toggle != 0);
+}
+
+void *PooledAllocator::AllocateUninitialized(size_t length) {
+  return AllocateFrom(length, false);
+}
+
+void *PooledAllocator::AllocateFrom(size_t length, bool zeroFill) {
+  int index = ClassIndex(length);
+
+  if (index < 0) {
+    void *data = zeroFill ? std::calloc(1, length) : std::malloc(length);
+    if (data == nullptr)
+      return nullptr;
+
+    SizeClass_t &large = classes[kClassCount];
+    std::lock_guard<std::mutex> lock(large.mutex);
+    large.stats.allocations++;
+    large.stats.bytes += length;
+    if (large.stats.bytes > large.stats.peakBytes)
+      large.stats.peakBytes = large.stats.bytes;
+    return data;
+  }
+
+  SizeClass_t &sizeClass = classes[index];
+  size_t size = sizeClass.stats.size;
+  void *data = nullptr;
+  {
+    std::lock_guard<std::mutex> lock(sizeClass.mutex);
+    if (sizeClass.freeList != nullptr) {
+      data = sizeClass.freeList;
+      sizeClass.freeList = sizeClass.freeList->next;
+      sizeClass.stats.cachedBytes -= size;
+      sizeClass.stats.poolHits++;
+    }
+    sizeClass.stats.allocations++;
+    sizeClass.stats.bytes += size;
+    if (sizeClass.stats.bytes > sizeClass.stats.peakBytes)
+      sizeClass.stats.peakBytes = sizeClass.stats.bytes;
+  }
+
+  if (data != nullptr) {
+    // reused blocks hold old contents
+    if (zeroFill)
+      std::memset(data, 0, length);
+    return data;
+  }
+
+  data = zeroFill ? std::calloc(1, size) : std::malloc(size);
+  if (data == nullptr) {
+    std::lock_guard<std::mutex> lock(sizeClass.mutex);
+    sizeClass.stats.allocations--;
+    sizeClass.stats.bytes -= size;
+  }
+  return data;
+}
+
+void PooledAllocator::Free(void *data, size_t length) {
+  if (data == nullptr)
+    return;
+
+  int index = ClassIndex(length);
+
+  if (index < 0) {
+    {
+      SizeClass_t &large = classes[kClassCount];
+      std::lock_guard<std::mutex> lock(large.mutex);
+      large.stats.frees++;
+      large.stats.bytes -= length;
+    }
+    std::free(data);
+    return;
+  }
+
+  SizeClass_t &sizeClass = classes[index];
+  size_t size = sizeClass.stats.size;
+  {
+    std::lock_guard<std::mutex> lock(sizeClass.mutex);
+    sizeClass.stats.frees++;
+    sizeClass.stats.bytes -= size;
+
+    if (sizeClass.stats.cachedBytes + size <= maxCachedBytes) {
+      FreeBlock_t *block = static_cast<FreeBlock_t *>(data);
+      block->next = sizeClass.freeList;
+      sizeClass.freeList = block;
+      sizeClass.stats.cachedBytes += size;
+      return;
+    }
+  }
+  std::free(data);
+}
+
+void PooledAllocator::Trim() {
+  for (size_t i = 0; i < kClassCount; i++) {
+    FreeBlock_t *block;
+    {
+      std::lock_guard<std::mutex> lock(classes[i].mutex);
+      block = classes[i].freeList;
+      classes[i].freeList = nullptr;
+      classes[i].stats.cachedBytes = 0;
+    }
+
+    while (block != nullptr) {
+      FreeBlock_t *next = block->next;
+      std::free(block);
+      block = next;
+    }
+  }
+}
+
+std::vector<PooledAllocator::ClassStats_t> PooledAllocator::GetStats() {
+  std::vector<ClassStats_t> stats;
+  stats.reserve(kClassCount + 1);
+  for (auto &sizeClass : classes) {
+    std::lock_guard<std::mutex> lock(sizeClass.mutex);
+    stats.push_back(sizeClass.stats);
+  }
+  return stats;
+}
+} // namespace sampnode
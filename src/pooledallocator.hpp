@@ -0,0 +1,64 @@
+#pragma once
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <mutex>
+#include <vector>
+
+#include "v8.h"
+
+namespace sampnode {
+// ArrayBuffer allocator keeping free lists of small backing stores per power
+// of two size class. Blocks are only zero-filled when V8 asks for initialized
+// memory. Larger buffers go straight to malloc but are still counted.
+// V8 frees backing stores from its GC threads, so every class is locked.
+class PooledAllocator : public v8::ArrayBuffer::Allocator {
+public:
+  static constexpr size_t kMinClassSize = 16;
+  static constexpr size_t kClassCount = 11; // 16 B .. 16 KB
+
+  struct ClassStats_t {
+    size_t size = 0; // block size, 0 for buffers too large to pool
+    uint64_t allocations = 0;
+    uint64_t frees = 0;
+    uint64_t poolHits = 0;
+    uint64_t bytes = 0; // currently allocated
+    uint64_t peakBytes = 0;
+    uint64_t cachedBytes = 0;
+  };
+
+  explicit PooledAllocator(size_t maxCachedBytesPerClass);
+  ~PooledAllocator() override;
+
+  void *Allocate(size_t length) override;
+  void *AllocateUninitialized(size_t length) override;
+  void Free(void *data, size_t length) override;
+
+  // Buffer's zero-fill flag in node's allocator. While it is 0, Allocate
+  // leaves the memory uninitialized like node's allocator would.
+  void SetZeroFillToggle(const uint32_t *toggle) { zeroFillToggle = toggle; }
+
+  // gives every cached block back to malloc
+  void Trim();
+  // one entry per size class, the unpooled class last
+  std::vector<ClassStats_t> GetStats();
+
+private:
+  struct FreeBlock_t {
+    FreeBlock_t *next;
+  };
+
+  struct SizeClass_t {
+    std::mutex mutex;
+    FreeBlock_t *freeList = nullptr;
+    ClassStats_t stats;
+  };
+
+  void *AllocateFrom(size_t length, bool zeroFill);
+  static int ClassIndex(size_t length);
+
+  SizeClass_t classes[kClassCount + 1];
+  size_t maxCachedBytes;
+  std::atomic<const uint32_t *> zeroFillToggle{nullptr};
+};
+} // namespace sampnode
@@ -0,0 +1,257 @@
+#include "profiler.hpp"
+
+#include <chrono>
+#include <fstream>
+#include <string>
+
+#include "utils.hpp"
+
+namespace sampnode {
+namespace profiler {
+namespace {
+using Clock = std::chrono::steady_clock;
+
+v8::CpuProfiler *cpuProfiler = nullptr;
+v8::ProfilerId sessionId = 0;
+bool running = false;
+bool automatic = false;
+Clock::time_point startedAt;
+
+int defaultSamplingUs = 1000;
+uint64_t thresholdNs = 0;
+int tickCount = 5;
+std::chrono::milliseconds duration(5000);
+std::chrono::milliseconds cooldown(60000);
+int slowTicks = 0;
+Clock::time_point cooldownUntil;
+
+// only touched by the thread that owns the isolate
+int timeDepth = 0;
+uint64_t tickJsNs = 0;
+
+bool begin(v8::Isolate *isolate, int samplingUs, bool isAutomatic) {
+  if (running)
+    return false;
+
+  if (cpuProfiler == nullptr)
+    cpuProfiler = v8::CpuProfiler::New(isolate);
+
+  // automatic sessions have a known length, keep their buffer bounded too
+  // and a session shorter than one sample still records that one
+  unsigned maxSamples = v8::CpuProfilingOptions::kNoSampleLimit;
+  if (isAutomatic) {
+    int64_t samples = duration.count() * 1000 / samplingUs * 2;
+    maxSamples = samples > 0 ? static_cast<unsigned>(samples) : 1;
+  }
+
+  cpuProfiler->SetSamplingInterval(samplingUs);
+  v8::CpuProfilingResult result = cpuProfiler->Start(
+      v8::CpuProfilingOptions(v8::kLeafNodeLineNumbers, maxSamples));
+  if (result.status != v8::CpuProfilingStatus::kStarted)
+    return false;
+
+  sessionId = result.id;
+  running = true;
+  automatic = isAutomatic;
+  startedAt = Clock::now();
+  return true;
+}
+
+void add_node(const v8::CpuProfileNode *node, json &nodes) {
+  json children = json::array();
+  for (int i = 0; i < node->GetChildrenCount(); i++)
+    children.push_back(node->GetChild(i)->GetNodeId());
+
+  // DevTools expects zero-based positions
+  nodes.push_back(
+      {{"id", node->GetNodeId()},
+       {"callFrame",
+        {{"functionName", node->GetFunctionNameStr()},
+         {"scriptId", std::to_string(node->GetScriptId())},
+         {"url", node->GetScriptResourceNameStr()},
+         {"lineNumber", node->GetLineNumber() - 1},
+         {"columnNumber", node->GetColumnNumber() - 1}}},
+       {"hitCount", node->GetHitCount()},
+       {"children", children}});
+
+  for (int i = 0; i < node->GetChildrenCount(); i++)
+    add_node(node->GetChild(i), nodes);
+}
+
+bool write(const v8::CpuProfile *profile, const std::string &path) {
+  json nodes = json::array();
+  add_node(profile->GetTopDownRoot(), nodes);
+
+  json samples = json::array();
+  json timeDeltas = json::array();
+  int64_t last = profile->GetStartTime();
+  for (int i = 0; i < profile->GetSamplesCount(); i++) {
+    samples.push_back(profile->GetSample(i)->GetNodeId());
+    int64_t timestamp = profile->GetSampleTimestamp(i);
+    timeDeltas.push_back(timestamp - last);
+    last = timestamp;
+  }
+
+  std::ofstream file(path, std::ofstream::out | std::ofstream::trunc);
+  if (!file.is_open())
+    return false;
+
+  file << json{{"nodes", nodes},
+               {"startTime", profile->GetStartTime()},
+               {"endTime", profile->GetEndTime()},
+               {"samples", samples},
+               {"timeDeltas", timeDeltas}}
+              .dump();
+  return file.good();
+}
+
+// empty when nothing was running or the file could not be written
+std::string finish(const std::string &path) {
+  if (!running)
+    return "";
+
+  running = false;
+  v8::CpuProfile *profile = cpuProfiler->Stop(sessionId);
+  if (profile == nullptr)
+    return "";
+
+  bool written = write(profile, path);
+  profile->Delete();
+
+  if (!written) {
+    L_ERROR << "Unable to write CPU profile " << path;
+    return "";
+  }
+  return path;
+}
+} // namespace
+
+void install(v8::Isolate *isolate, const Props_t &config) {
+  if (config.profile_sampling_us > 0)
+    defaultSamplingUs = config.profile_sampling_us;
+  thresholdNs =
+      static_cast<uint64_t>(config.profile_tick_threshold_ms) * 1000000;
+  tickCount = config.profile_tick_count > 0 ? config.profile_tick_count : 1;
+  duration = std::chrono::milliseconds(config.profile_duration_ms);
+  cooldown = std::chrono::milliseconds(config.profile_cooldown_ms);
+}
+
+void uninstall(v8::Isolate *isolate) {
+  if (cpuProfiler == nullptr)
+    return;
+
+  v8::Locker locker(isolate);
+  v8::Isolate::Scope isolateScope(isolate);
+  v8::HandleScope scope(isolate);
+
+  if (running) {
+    running = false;
+    if (v8::CpuProfile *profile = cpuProfiler->Stop(sessionId))
+      profile->Delete();
+  }
+
+  cpuProfiler->Dispose();
+  cpuProfiler = nullptr;
+}
+
+TimeScope::TimeScope() {
+  if (thresholdNs == 0)
+    return;
+  outer = timeDepth++ == 0;
+  if (outer)
+    start = Clock::now();
+}
+
+TimeScope::~TimeScope() {
+  if (thresholdNs == 0)
+    return;
+  timeDepth--;
+  if (!outer)
+    return;
+
+  uint64_t elapsedNs = std::chrono::duration_cast<std::chrono::nanoseconds>(
+                           Clock::now() - start)
+                           .count();
+  if (elapsedNs > excludedNs)
+    tickJsNs += elapsedNs - excludedNs;
+}
+
+void on_tick(v8::Isolate *isolate) {
+  auto now = Clock::now();
+  uint64_t elapsedNs = tickJsNs;
+  tickJsNs = 0;
+
+  if (running) {
+    if (!automatic || now - startedAt < duration)
+      return;
+
+    v8::Locker locker(isolate);
+    v8::Isolate::Scope isolateScope(isolate);
+    v8::HandleScope scope(isolate);
+
+    std::string path = finish(utils::timestamped_file(".cpuprofile"));
+    if (!path.empty())
+      L_WARN << "profile of slow ticks written to " << path;
+    cooldownUntil = now + cooldown;
+    return;
+  }
+
+  if (thresholdNs == 0)
+    return;
+
+  if (elapsedNs < thresholdNs) {
+    slowTicks = 0;
+    return;
+  }
+
+  if (++slowTicks < tickCount || now < cooldownUntil)
+    return;
+  slowTicks = 0;
+
+  v8::Locker locker(isolate);
+  v8::Isolate::Scope isolateScope(isolate);
+  v8::HandleScope scope(isolate);
+
+  if (begin(isolate, defaultSamplingUs, true)) {
+    L_WARN << tickCount << " ticks in a row took longer than "
+           << thresholdNs / 1000000 << "ms, profiling for "
+           << duration.count() << "ms";
+  }
+}
+
+void start(const v8::FunctionCallbackInfo<v8::Value> &info) {
+  v8::Isolate *isolate = info.GetIsolate();
+  v8::HandleScope scope(isolate);
+
+  int samplingUs = defaultSamplingUs;
+  if (info.Length() > 0 && info[0]->IsNumber()) {
+    samplingUs =
+        info[0]->Int32Value(isolate->GetCurrentContext()).FromMaybe(0);
+    if (samplingUs <= 0)
+      samplingUs = defaultSamplingUs;
+  }
+
+  info.GetReturnValue().Set(begin(isolate, samplingUs, false));
+}
+
+void stop(const v8::FunctionCallbackInfo<v8::Value> &info) {
+  v8::Isolate *isolate = info.GetIsolate();
+  v8::HandleScope scope(isolate);
+
+  std::string path;
+  if (info.Length() > 0 && info[0]->IsString())
+    path = *v8::String::Utf8Value(isolate, info[0]);
+  if (path.empty())
+    path = utils::timestamped_file(".cpuprofile");
+
+  path = finish(path);
+  if (path.empty()) {
+    info.GetReturnValue().SetNull();
+    return;
+  }
+
+  info.GetReturnValue().Set(
+      v8::String::NewFromUtf8(isolate, path.c_str()).ToLocalChecked());
+}
+} // namespace profiler
+} // namespace sampnode
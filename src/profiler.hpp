@@ -0,0 +1,47 @@
+#pragma once
+#include <chrono>
+#include <cstdint>
+
+#include "config.hpp"
+#include "node.h"
+#include "v8.h"
+#include "v8-profiler.h"
+
+namespace sampnode {
+namespace profiler {
+// Sampling CPU profiles without an inspector. Sessions are started from JS
+// or, with profile_tick_threshold_ms set, when several ticks in a row are
+// too slow, and are written as .cpuprofile files DevTools can open.
+void install(v8::Isolate *isolate, const Props_t &config);
+// drops a running session and frees the profiler, before the isolate goes
+void uninstall(v8::Isolate *isolate);
+
+// Counts JS time towards the current tick, for profile_tick_threshold_ms.
+// Only the outermost scope counts, so listeners run inside a tick, or ticks
+// run by a listener that awaits a promise, aren't counted twice.
+class TimeScope {
+public:
+  TimeScope();
+  ~TimeScope();
+
+  TimeScope(const TimeScope &) = delete;
+  TimeScope &operator=(const TimeScope &) = delete;
+
+  // time inside this scope that was spent waiting, not running JS
+  void Exclude(uint64_t ns) { excludedNs += ns; }
+
+private:
+  bool outer = false;
+  std::chrono::steady_clock::time_point start;
+  uint64_t excludedNs = 0;
+};
+
+// Once per server tick, or per round of the JS thread's loop, on the thread
+// that owns the isolate. Checks the JS time counted since the last call.
+void on_tick(v8::Isolate *isolate);
+
+// samp.profiler.start([samplingUs]) and samp.profiler.stop([path])
+void start(const v8::FunctionCallbackInfo<v8::Value> &info);
+void stop(const v8::FunctionCallbackInfo<v8::Value> &info);
+} // namespace profiler
+} // namespace sampnode
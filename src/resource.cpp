@@ -4,6 +4,7 @@
 #include "functions.hpp"
 #include "logger.hpp"
 #include "nodeimpl.hpp"
+#include "workers.hpp"
 
 namespace sampnode {
 
@@ -22,6 +23,61 @@ void LogV8Error(v8::Isolate *isolate, const v8::TryCatch &try_catch) {
     L_ERROR << *filename << ":" << linenum << ": " << *exception;
   }
 }
+
+// runs a script that evaluates to a function and calls it with argv
+void CallSetupScript(v8::Isolate *isolate, v8::Local<v8::Context> context,
+                     const std::string &code, int argc,
+                     v8::Local<v8::Value> argv[]) {
+  v8::TryCatch tryCatch(isolate);
+
+  v8::Local<v8::String> source =
+      v8::String::NewFromUtf8(isolate, code.c_str()).ToLocalChecked();
+  v8::Local<v8::Script> script;
+  v8::Local<v8::Value> setup;
+  if (!v8::Script::Compile(context, source).ToLocal(&script) ||
+      !script->Run(context).ToLocal(&setup) || !setup->IsFunction()) {
+    LogV8Error(isolate, tryCatch);
+    return;
+  }
+
+  if (setup.As<v8::Function>()
+          ->Call(context, context->Global(), argc, argv)
+          .IsEmpty())
+    LogV8Error(isolate, tryCatch);
+}
+
+// replaces process.stdout/stderr and console.* before any user code runs
+void RouteConsole(v8::Isolate *isolate, v8::Local<v8::Context> context,
+                  int batchMs) {
+  v8::Local<v8::Value> argv[] = {
+      v8::Function::New(context, functions::console_write).ToLocalChecked(),
+      v8::Integer::New(isolate, batchMs)};
+  CallSetupScript(isolate, context, consoleRouting, 2, argv);
+}
+
+void SetZeroFillToggle(const v8::FunctionCallbackInfo<v8::Value> &info) {
+  PooledAllocator *allocator = nodeImpl.GetPooledAllocator();
+  if (allocator == nullptr || info.Length() < 1 || !info[0]->IsUint32Array())
+    return;
+
+  v8::Local<v8::Uint32Array> toggle = info[0].As<v8::Uint32Array>();
+  allocator->SetZeroFillToggle(reinterpret_cast<const uint32_t *>(
+      static_cast<char *>(toggle->Buffer()->Data()) + toggle->ByteOffset()));
+}
+
+// lets the pool skip zero-filling for Buffer.allocUnsafe like node's
+// allocator does, unless --zero-fill-buffers asks for it anyway
+void LinkZeroFillToggle(v8::Isolate *isolate, v8::Local<v8::Context> context,
+                        const Props_t &config) {
+  for (const std::string &flag : config.node_flags) {
+    if (flag == "--zero-fill-buffers")
+      return;
+  }
+
+  v8::Local<v8::Value> argv[] = {
+      v8::Function::New(context, SetZeroFillToggle).ToLocalChecked()};
+  CallSetupScript(isolate, context, zeroFillToggle, 1, argv);
+}
 } // namespace
 
 Resource::Resource()
@@ -35,24 +91,60 @@ void Resource::Init() {
   v8::Isolate::Scope isolateScope(isolate);
   v8::HandleScope handleScope(isolate);
 
-  v8::Local<v8::ObjectTemplate> global = v8::ObjectTemplate::New(isolate);
-  sampnode::functions::init(isolate, global);
-
-  v8::Local<v8::Context> context = node::NewContext(isolate, global);
-  this->context.Reset(isolate, context);
-  v8::Context::Scope scope(context);
-
   node::EnvironmentFlags::Flags flags =
       static_cast<node::EnvironmentFlags::Flags>(
           node::EnvironmentFlags::kOwnsProcessState);
 
-  auto env = node::CreateEnvironment(sampnode::nodeImpl.GetNodeIsolate(),
-                                     context, {}, // args
-                                     {},          // exec_args
-                                     flags);
+  bool fromSnapshot = sampnode::nodeImpl.IsFromSnapshot();
+  node::Environment *env = nullptr;
+  v8::Local<v8::Context> context;
+
+  if (fromSnapshot) {
+    // the snapshot brings its own main context, globals are added afterwards
+    env = node::CreateEnvironment(sampnode::nodeImpl.GetNodeIsolate(),
+                                  v8::Local<v8::Context>(), {}, // args
+                                  {},                           // exec_args
+                                  flags);
+    if (env) {
+      context = node::GetMainContext(env);
+      sampnode::functions::install(isolate, context);
+    }
+  } else {
+    v8::Local<v8::ObjectTemplate> global = v8::ObjectTemplate::New(isolate);
+    sampnode::functions::init(isolate, global);
+
+    context = node::NewContext(isolate, global);
+    v8::Context::Scope scope(context);
+
+    env = node::CreateEnvironment(sampnode::nodeImpl.GetNodeIsolate(), context,
+                                  {}, // args
+                                  {}, // exec_args
+                                  flags);
+  }
+
+  if (!context.IsEmpty())
+    this->context.Reset(isolate, context);
 
   if (env) {
-    node::LoadEnvironment(env, bootstrap.c_str());
+    v8::Context::Scope scope(context);
+
+    // inherited by every worker spawned from this environment
+    node::AddLinkedBinding(env, "samp", workers::init_binding, nullptr);
+
+    const Props_t &config = sampnode::nodeImpl.GetMainConfig();
+    if (config.console_to_log)
+      RouteConsole(isolate, context, config.console_batch_ms);
+    if (sampnode::nodeImpl.GetPooledAllocator())
+      LinkZeroFillToggle(isolate, context, config);
+
+    if (fromSnapshot) {
+      CallSetupScript(isolate, context, dnsResultOrder, 0, nullptr);
+      // runs the function the builder passed to setDeserializeMainFunction
+      node::LoadEnvironment(env, node::StartExecutionCallback{});
+      NodeImpl::esmLoading = false;
+    } else {
+      node::LoadEnvironment(env, bootstrap.c_str());
+    }
     nodeEnvironment.reset(env);
 
     v8::Local<v8::Object> asyncResourceObj = v8::Object::New(isolate);
@@ -66,6 +158,9 @@ void Resource::Init() {
 }
 
 void Resource::Stop() {
+  if (context.IsEmpty())
+    return;
+
   v8::Isolate *isolate = sampnode::nodeImpl.GetIsolate();
   v8::Locker locker(isolate);
   v8::Isolate::Scope isolateScope(isolate);
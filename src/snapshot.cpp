@@ -0,0 +1,118 @@
+#include "snapshot.hpp"
+
+#include <chrono>
+#include <cstdio>
+#include <fstream>
+#include <memory>
+#include <sstream>
+#include <vector>
+
+#include <sys/stat.h>
+
+#include "logger.hpp"
+
+namespace sampnode {
+namespace snapshot {
+namespace {
+using FilePtr = std::unique_ptr<FILE, int (*)(FILE *)>;
+
+bool modified_time(const std::string &path, time_t &time) {
+  struct stat info;
+  if (stat(path.c_str(), &info) != 0)
+    return false;
+  time = info.st_mtime;
+  return true;
+}
+} // namespace
+
+bool is_stale(const std::string &builder, const std::string &blob) {
+  time_t builderTime, blobTime;
+  if (!modified_time(blob, blobTime))
+    return true;
+  return modified_time(builder, builderTime) && builderTime > blobTime;
+}
+
+bool build(node::MultiIsolatePlatform *platform, const std::string &builder,
+           const std::string &blob) {
+  auto start = std::chrono::steady_clock::now();
+
+  std::ifstream file(builder, std::ios::binary);
+  if (!file.is_open()) {
+    L_ERROR << "Unable to open snapshot builder " << builder;
+    return false;
+  }
+  std::stringstream source;
+  source << file.rdbuf();
+
+  // args[1] is used for __filename and __dirname of the builder script
+  std::vector<std::string> errors;
+  std::vector<std::string> args = {"", builder};
+  node::SnapshotConfig config;
+  config.builder_script_path = builder;
+
+  auto setup = node::CommonEnvironmentSetup::CreateForSnapshotting(
+      platform, &errors, args, {}, config);
+  if (!setup) {
+    for (const std::string &error : errors)
+      L_ERROR << "snapshot: " << error;
+    return false;
+  }
+
+  v8::Isolate *isolate = setup->isolate();
+  v8::Locker locker(isolate);
+  v8::Isolate::Scope isolateScope(isolate);
+
+  {
+    v8::HandleScope handleScope(isolate);
+    v8::Context::Scope contextScope(setup->context());
+
+    if (node::LoadEnvironment(setup->env(), source.str()).IsEmpty()) {
+      L_ERROR << "snapshot builder " << builder << " threw an exception";
+      return false;
+    }
+
+    int exitCode = node::SpinEventLoop(setup->env()).FromMaybe(1);
+    if (exitCode != 0) {
+      L_ERROR << "snapshot builder " << builder << " exited with code "
+              << exitCode;
+      return false;
+    }
+  }
+
+  node::EmbedderSnapshotData::Pointer data = setup->CreateSnapshot();
+  if (!data) {
+    L_ERROR << "Failed to create a snapshot from " << builder;
+    return false;
+  }
+
+  FilePtr out(fopen(blob.c_str(), "wb"), fclose);
+  if (!out) {
+    L_ERROR << "Unable to write snapshot blob " << blob;
+    return false;
+  }
+  data->ToFile(out.get());
+
+  L_INFO << "snapshot " << blob << " built from " << builder << " in "
+         << std::chrono::duration_cast<std::chrono::milliseconds>(
+                std::chrono::steady_clock::now() - start)
+                .count()
+         << "ms";
+  return true;
+}
+
+node::EmbedderSnapshotData::Pointer load(const std::string &blob) {
+  FilePtr in(fopen(blob.c_str(), "rb"), fclose);
+  if (!in) {
+    L_ERROR << "Unable to open snapshot blob " << blob;
+    return {};
+  }
+
+  node::EmbedderSnapshotData::Pointer data =
+      node::EmbedderSnapshotData::FromFile(in.get());
+  if (!data)
+    L_ERROR << "Snapshot blob " << blob
+            << " is invalid or was built by a different Node.js version";
+  return data;
+}
+} // namespace snapshot
+} // namespace sampnode
@@ -0,0 +1,19 @@
+#pragma once
+#include <string>
+
+#include "node.h"
+
+namespace sampnode {
+namespace snapshot {
+// true when the blob is missing or older than the builder script
+bool is_stale(const std::string &builder, const std::string &blob);
+
+// Runs the builder script in a snapshotting environment until its event loop
+// is empty and writes the resulting startup snapshot to blob.
+bool build(node::MultiIsolatePlatform *platform, const std::string &builder,
+           const std::string &blob);
+
+// Empty when the file can't be read or was built by another Node.js version.
+node::EmbedderSnapshotData::Pointer load(const std::string &blob);
+} // namespace snapshot
+} // namespace sampnode
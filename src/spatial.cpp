@@ -0,0 +1,209 @@
+#include "spatial.hpp"
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <memory>
+#include <vector>
+
+#include "logger.hpp"
+#include "natives.hpp"
+#include "sampgdk.h"
+#include "spatialgrid.hpp"
+#include "trace.hpp"
+
+namespace sampnode {
+namespace spatial {
+namespace {
+enum Kind { Players = 0, Vehicles = 1, KindCount };
+
+constexpr int kMaxVehicles = 2000;
+
+struct Source_t {
+  const char *poolSize;
+  const char *valid;
+  const char *position;
+  const char *world;
+  int maxSize;
+
+  bool resolved = false;
+  AMX_NATIVE poolSizeAddress = nullptr;
+  AMX_NATIVE validAddress = nullptr;
+  AMX_NATIVE positionAddress = nullptr;
+  AMX_NATIVE worldAddress = nullptr;
+};
+
+bool enabled = false;
+float cellSize = 50.0f;
+Source_t sources[KindCount] = {
+    {"GetPlayerPoolSize", "IsPlayerConnected", "GetPlayerPos",
+     "GetPlayerVirtualWorld", 1000},
+    {"GetVehiclePoolSize", "GetVehicleModel", "GetVehiclePos",
+     "GetVehicleVirtualWorld", kMaxVehicles},
+};
+// swapped whole by refresh, queries keep the one they started with
+std::shared_ptr<const Index_t> indices[KindCount];
+
+void resolve(Source_t &source) {
+  if (source.resolved)
+    return;
+  source.poolSizeAddress = native::get_address(source.poolSize);
+  source.validAddress = native::get_address(source.valid);
+  source.positionAddress = native::get_address(source.position);
+  source.worldAddress = native::get_address(source.world);
+  source.resolved = true;
+}
+
+std::shared_ptr<const Index_t> build(Source_t &source) {
+  resolve(source);
+  std::vector<Entry_t> entries;
+  if (!source.validAddress || !source.positionAddress)
+    return build_index(entries, cellSize);
+
+  int limit = source.maxSize;
+  if (source.poolSizeAddress)
+    limit = sampgdk::InvokeNativeArray(source.poolSizeAddress, "", nullptr) + 1;
+  entries.reserve(limit);
+
+  cell id = 0;
+  cell values[3];
+  void *args[] = {&id, &values[0], &values[1], &values[2]};
+  for (; id < limit; id++) {
+    if (!sampgdk::InvokeNativeArray(source.validAddress, "i", args))
+      continue;
+
+    sampgdk::InvokeNativeArray(source.positionAddress, "iRRR", args);
+    Entry_t entry;
+    entry.id = id;
+    entry.world = 0;
+    if (source.worldAddress)
+      entry.world = sampgdk::InvokeNativeArray(source.worldAddress, "i", args);
+    entry.x = amx_ctof(values[0]);
+    entry.y = amx_ctof(values[1]);
+    entry.z = amx_ctof(values[2]);
+    // a script can teleport anything to NaN, which no distance would match
+    if (!std::isfinite(entry.x) || !std::isfinite(entry.y) ||
+        !std::isfinite(entry.z))
+      continue;
+    entries.push_back(entry);
+  }
+  return build_index(entries, cellSize);
+}
+
+struct Query_t {
+  float x, y, z;
+  double amount; // radius or k
+  int32_t world;
+  int32_t *out;
+  uint32_t capacity;
+  std::shared_ptr<const Index_t> index;
+};
+
+bool prepare(const v8::FunctionCallbackInfo<v8::Value> &info,
+             const char *name, Query_t &query) {
+  v8::Isolate *isolate = info.GetIsolate();
+  v8::Local<v8::Context> context = isolate->GetCurrentContext();
+
+  if (!enabled)
+    return false;
+
+  if (info.Length() < 6 || !info[0]->IsNumber() || !info[1]->IsNumber() ||
+      !info[2]->IsNumber() || !info[3]->IsNumber() || !info[4]->IsNumber() ||
+      !info[5]->IsInt32Array()) {
+    L_ERROR << "spatial." << name
+            << ": expected (x, y, z, " << (name[0] == 'k' ? "k" : "r")
+            << ", worldid, out: Int32Array, kind?)";
+    return false;
+  }
+
+  int kind = Players;
+  if (info.Length() > 6 && info[6]->IsNumber())
+    kind = info[6]->Int32Value(context).FromMaybe(Players);
+  if (kind < 0 || kind >= KindCount) {
+    L_ERROR << "spatial." << name << ": unknown kind " << kind;
+    return false;
+  }
+
+  query.x = static_cast<float>(info[0]->NumberValue(context).FromMaybe(0));
+  query.y = static_cast<float>(info[1]->NumberValue(context).FromMaybe(0));
+  query.z = static_cast<float>(info[2]->NumberValue(context).FromMaybe(0));
+  query.amount = info[3]->NumberValue(context).FromMaybe(0);
+  query.world = info[4]->Int32Value(context).FromMaybe(-1);
+  if (!std::isfinite(query.x) || !std::isfinite(query.y) ||
+      !std::isfinite(query.z) || std::isnan(query.amount)) {
+    L_ERROR << "spatial." << name << ": position and "
+            << (name[0] == 'k' ? "k" : "r") << " must be finite";
+    return false;
+  }
+
+  v8::Local<v8::Int32Array> out = info[5].As<v8::Int32Array>();
+  query.out = reinterpret_cast<int32_t *>(
+      static_cast<char *>(out->Buffer()->Data()) + out->ByteOffset());
+  query.capacity = static_cast<uint32_t>(out->Length());
+
+  query.index = std::atomic_load(&indices[kind]);
+  return query.index != nullptr;
+}
+} // namespace
+
+void init(const Props_t &config) {
+  enabled = config.spatial_index;
+  if (config.spatial_cell_size > 0)
+    cellSize = config.spatial_cell_size;
+
+  if (!enabled)
+    return;
+
+  const char *kernel = select_kernel();
+  L_DEBUG << "spatial index: cell size " << cellSize << ", " << kernel
+          << " distance kernel";
+}
+
+void refresh() {
+  if (!enabled)
+    return;
+
+  trace::Span span(trace::Category::Tick, "spatial index");
+  for (int kind = 0; kind < KindCount; kind++)
+    std::atomic_store(&indices[kind], build(sources[kind]));
+}
+
+void query_radius(const v8::FunctionCallbackInfo<v8::Value> &info) {
+  Query_t q;
+  if (!prepare(info, "queryRadius", q)) {
+    info.GetReturnValue().Set(-1);
+    return;
+  }
+
+  info.GetReturnValue().Set(find_in_radius(*q.index, q.x, q.y, q.z,
+                                           static_cast<float>(q.amount),
+                                           q.world, q.out, q.capacity));
+}
+
+void k_nearest(const v8::FunctionCallbackInfo<v8::Value> &info) {
+  Query_t q;
+  if (!prepare(info, "kNearest", q)) {
+    info.GetReturnValue().Set(-1);
+    return;
+  }
+
+  size_t k = std::min<size_t>(q.capacity,
+                              q.amount > 0 ? static_cast<size_t>(q.amount) : 0);
+  info.GetReturnValue().Set(
+      find_nearest(*q.index, q.x, q.y, q.z, k, q.world, q.out));
+}
+
+v8::Local<v8::ObjectTemplate> make_object(v8::Isolate *isolate) {
+  v8::Local<v8::ObjectTemplate> object = v8::ObjectTemplate::New(isolate);
+  object->Set(v8::String::NewFromUtf8(isolate, "queryRadius").ToLocalChecked(),
+              v8::FunctionTemplate::New(isolate, query_radius));
+  object->Set(v8::String::NewFromUtf8(isolate, "kNearest").ToLocalChecked(),
+              v8::FunctionTemplate::New(isolate, k_nearest));
+  object->Set(v8::String::NewFromUtf8(isolate, "players").ToLocalChecked(),
+              v8::Integer::New(isolate, Players));
+  object->Set(v8::String::NewFromUtf8(isolate, "vehicles").ToLocalChecked(),
+              v8::Integer::New(isolate, Vehicles));
+  return object;
+}
+} // namespace spatial
+} // namespace sampnode
@@ -0,0 +1,24 @@
+#pragma once
+
+#include "config.hpp"
+#include "node.h"
+#include "v8.h"
+
+namespace sampnode {
+namespace spatial {
+// With spatial_index, the positions of players and vehicles are read once
+// per server tick into a uniform grid. Queries from JS run against the last
+// finished grid, from any thread, without calling a native.
+void init(const Props_t &config);
+
+// server thread, once per ProcessTick
+void refresh();
+
+// samp.spatial.queryRadius(x, y, z, r, worldid, out[, kind]) and
+// samp.spatial.kNearest(x, y, z, k, worldid, out[, kind])
+void query_radius(const v8::FunctionCallbackInfo<v8::Value> &info);
+void k_nearest(const v8::FunctionCallbackInfo<v8::Value> &info);
+
+v8::Local<v8::ObjectTemplate> make_object(v8::Isolate *isolate);
+} // namespace spatial
+} // namespace sampnode
@@ -0,0 +1,245 @@
+#include "spatialgrid.hpp"
+
+#include <algorithm>
+#include <cmath>
+
+// The x86 Linux build targets i686, which doesn't include SSE2, so the
+// kernel is compiled for it separately and picked at runtime.
+#if defined(__GNUC__) && (defined(__i386__) || defined(__x86_64__))
+#include <emmintrin.h>
+#define SPATIAL_SSE2 __attribute__((target("sse2")))
+#elif defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#include <emmintrin.h>
+#define SPATIAL_SSE2
+#endif
+
+namespace sampnode {
+namespace spatial {
+namespace {
+// distances are computed in blocks of this size, then filtered
+constexpr size_t kBlock = 64;
+// radius doublings of find_nearest, from the cell size far past any map
+constexpr int kMaxGrowSteps = 32;
+
+// clamped, a far away query must not overflow the conversion
+int32_t cell_coord(float value, float size) {
+  double coord = std::floor(static_cast<double>(value) / size);
+  return static_cast<int32_t>(std::max(-1e9, std::min(1e9, coord)));
+}
+
+uint64_t cell_key(int32_t cx, int32_t cy) {
+  return (static_cast<uint64_t>(static_cast<uint32_t>(cx)) << 32) |
+         static_cast<uint32_t>(cy);
+}
+
+// squared distances of n entries
+void distances_scalar(const float *x, const float *y, const float *z,
+                      size_t n, float qx, float qy, float qz, float *out) {
+  for (size_t i = 0; i < n; i++) {
+    float dx = x[i] - qx;
+    float dy = y[i] - qy;
+    float dz = z[i] - qz;
+    out[i] = dx * dx + dy * dy + dz * dz;
+  }
+}
+
+#ifdef SPATIAL_SSE2
+// the same, four entries at a time
+SPATIAL_SSE2 void distances_sse2(const float *x, const float *y,
+                                 const float *z, size_t n, float qx, float qy,
+                                 float qz, float *out) {
+  const __m128 px = _mm_set1_ps(qx);
+  const __m128 py = _mm_set1_ps(qy);
+  const __m128 pz = _mm_set1_ps(qz);
+
+  size_t i = 0;
+  for (; i + 4 <= n; i += 4) {
+    __m128 dx = _mm_sub_ps(_mm_loadu_ps(x + i), px);
+    __m128 dy = _mm_sub_ps(_mm_loadu_ps(y + i), py);
+    __m128 dz = _mm_sub_ps(_mm_loadu_ps(z + i), pz);
+    __m128 d2 = _mm_add_ps(_mm_add_ps(_mm_mul_ps(dx, dx), _mm_mul_ps(dy, dy)),
+                           _mm_mul_ps(dz, dz));
+    _mm_storeu_ps(out + i, d2);
+  }
+  distances_scalar(x + i, y + i, z + i, n - i, qx, qy, qz, out + i);
+}
+
+bool has_sse2() {
+#ifdef __GNUC__
+  return __builtin_cpu_supports("sse2");
+#else
+  return true; // only compiled in where SSE2 is the baseline
+#endif
+}
+#endif
+
+// picked by select_kernel
+void (*distances)(const float *, const float *, const float *, size_t, float,
+                  float, float, float *) = distances_scalar;
+
+// calls hit(entry, squared distance) for every entry of [begin, end) in
+// range
+template <typename F>
+void scan(const Index_t &index, uint32_t begin, uint32_t end, float qx,
+          float qy, float qz, float r2, int32_t world, F &&hit) {
+  float d2[kBlock];
+  for (uint32_t start = begin; start < end; start += kBlock) {
+    size_t n = std::min<size_t>(kBlock, end - start);
+    distances(&index.x[start], &index.y[start], &index.z[start], n, qx, qy,
+              qz, d2);
+    for (size_t i = 0; i < n; i++) {
+      if (d2[i] <= r2 && (world < 0 || index.worlds[start + i] == world))
+        hit(start + static_cast<uint32_t>(i), d2[i]);
+    }
+  }
+}
+
+template <typename F>
+void query(const Index_t &index, float qx, float qy, float qz, float r,
+           int32_t world, F &&hit) {
+  if (r < 0)
+    return;
+  const float r2 = r * r;
+  const float size = index.cellSize;
+  int32_t cx0 = cell_coord(qx - r, size), cx1 = cell_coord(qx + r, size);
+  int32_t cy0 = cell_coord(qy - r, size), cy1 = cell_coord(qy + r, size);
+
+  // a radius covering more cells than there are entries is cheaper to scan
+  double cellCount = (static_cast<double>(cx1) - cx0 + 1) *
+                     (static_cast<double>(cy1) - cy0 + 1);
+  if (cellCount >= static_cast<double>(index.cells.size())) {
+    scan(index, 0, static_cast<uint32_t>(index.ids.size()), qx, qy, qz, r2,
+         world, hit);
+    return;
+  }
+
+  for (int32_t cx = cx0; cx <= cx1; cx++) {
+    for (int32_t cy = cy0; cy <= cy1; cy++) {
+      auto iter = index.cells.find(cell_key(cx, cy));
+      if (iter == index.cells.end())
+        continue;
+      const auto &range = iter->second;
+      scan(index, range.first, range.first + range.second, qx, qy, qz, r2,
+           world, hit);
+    }
+  }
+}
+
+// distance from q to the farthest corner of the index' bounding box, every
+// entry is within it
+float reach(const Index_t &index, float qx, float qy, float qz) {
+  float dx = std::max(std::fabs(qx - index.minX), std::fabs(qx - index.maxX));
+  float dy = std::max(std::fabs(qy - index.minY), std::fabs(qy - index.maxY));
+  float dz = std::max(std::fabs(qz - index.minZ), std::fabs(qz - index.maxZ));
+  return std::sqrt(dx * dx + dy * dy + dz * dz);
+}
+
+} // namespace
+
+const char *select_kernel() {
+#ifdef SPATIAL_SSE2
+  if (has_sse2()) {
+    distances = distances_sse2;
+    return "sse2";
+  }
+#endif
+  return "scalar";
+}
+
+std::shared_ptr<const Index_t> build_index(const std::vector<Entry_t> &entries,
+                                           float cellSize) {
+  auto index = std::make_shared<Index_t>();
+  index->cellSize = cellSize;
+
+  struct Keyed_t {
+    uint64_t key;
+    Entry_t entry;
+  };
+  std::vector<Keyed_t> keyed;
+  keyed.reserve(entries.size());
+  for (const Entry_t &entry : entries) {
+    keyed.push_back({cell_key(cell_coord(entry.x, cellSize),
+                              cell_coord(entry.y, cellSize)),
+                     entry});
+  }
+
+  std::sort(keyed.begin(), keyed.end(),
+            [](const Keyed_t &a, const Keyed_t &b) { return a.key < b.key; });
+
+  size_t count = keyed.size();
+  index->ids.resize(count);
+  index->worlds.resize(count);
+  index->x.resize(count);
+  index->y.resize(count);
+  index->z.resize(count);
+  index->cells.reserve(count);
+
+  for (size_t i = 0; i < count; i++) {
+    const Entry_t &entry = keyed[i].entry;
+    index->ids[i] = entry.id;
+    index->worlds[i] = entry.world;
+    index->x[i] = entry.x;
+    index->y[i] = entry.y;
+    index->z[i] = entry.z;
+
+    auto &range = index->cells[keyed[i].key];
+    if (range.second == 0)
+      range.first = static_cast<uint32_t>(i);
+    range.second++;
+  }
+
+  if (count > 0) {
+    auto [minX, maxX] = std::minmax_element(index->x.begin(), index->x.end());
+    auto [minY, maxY] = std::minmax_element(index->y.begin(), index->y.end());
+    auto [minZ, maxZ] = std::minmax_element(index->z.begin(), index->z.end());
+    index->minX = *minX;
+    index->maxX = *maxX;
+    index->minY = *minY;
+    index->maxY = *maxY;
+    index->minZ = *minZ;
+    index->maxZ = *maxZ;
+  }
+  return index;
+}
+
+uint32_t find_in_radius(const Index_t &index, float x, float y, float z,
+                        float r, int32_t world, int32_t *out,
+                        uint32_t capacity) {
+  // counts every hit, so a caller can grow out when the result is bigger
+  uint32_t found = 0;
+  query(index, x, y, z, r, world, [&](uint32_t entry, float) {
+    if (found < capacity)
+      out[found] = index.ids[entry];
+    found++;
+  });
+  return found;
+}
+
+uint32_t find_nearest(const Index_t &index, float x, float y, float z,
+                      size_t k, int32_t world, int32_t *out) {
+  if (k == 0 || index.ids.empty() || !std::isfinite(x) || !std::isfinite(y) ||
+      !std::isfinite(z))
+    return 0;
+
+  // grow the radius until it holds k entries, those are then the k nearest
+  std::vector<std::pair<float, int32_t>> hits;
+  float limit = reach(index, x, y, z);
+  float r = index.cellSize;
+  for (int step = 0; step < kMaxGrowSteps; step++, r *= 2) {
+    hits.clear();
+    query(index, x, y, z, std::min(r, limit), world,
+          [&](uint32_t entry, float d2) {
+            hits.emplace_back(d2, index.ids[entry]);
+          });
+    if (hits.size() >= k || r >= limit)
+      break;
+  }
+
+  k = std::min(k, hits.size());
+  std::partial_sort(hits.begin(), hits.begin() + k, hits.end());
+  for (size_t i = 0; i < k; i++)
+    out[i] = hits[i].second;
+  return static_cast<uint32_t>(k);
+}
+} // namespace spatial
+} // namespace sampnode
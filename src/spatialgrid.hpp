@@ -0,0 +1,50 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+namespace sampnode {
+namespace spatial {
+// The grid behind samp.spatial. It knows nothing of natives or V8, so the
+// benchmark in bench/ builds it from synthetic entries.
+struct Entry_t {
+  int32_t id;
+  int32_t world;
+  float x, y, z;
+};
+
+// Entries sorted by grid cell, so the entries of a cell are contiguous and
+// their coordinates can be scanned as plain float arrays.
+struct Index_t {
+  float cellSize = 50.0f;
+  std::vector<int32_t> ids;
+  std::vector<int32_t> worlds;
+  std::vector<float> x;
+  std::vector<float> y;
+  std::vector<float> z;
+  // cell key -> first entry, entry count
+  std::unordered_map<uint64_t, std::pair<uint32_t, uint32_t>> cells;
+  float minX = 0, minY = 0, minZ = 0, maxX = 0, maxY = 0, maxZ = 0;
+};
+
+// uses the SSE2 distance kernel from now on when the CPU has it, returns the
+// name of the kernel in use
+const char *select_kernel();
+
+std::shared_ptr<const Index_t> build_index(const std::vector<Entry_t> &entries,
+                                           float cellSize);
+
+// Writes the ids within r of the point to out, at most capacity of them, and
+// returns how many there are in total. world -1 matches any world.
+uint32_t find_in_radius(const Index_t &index, float x, float y, float z,
+                        float r, int32_t world, int32_t *out,
+                        uint32_t capacity);
+// Writes the ids of the k nearest entries to out, nearest first, and returns
+// how many were written.
+uint32_t find_nearest(const Index_t &index, float x, float y, float z,
+                      size_t k, int32_t world, int32_t *out);
+} // namespace spatial
+} // namespace sampnode
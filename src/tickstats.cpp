@@ -0,0 +1,210 @@
+#include "tickstats.hpp"
+
+#include <cmath>
+#include <mutex>
+
+#include "logger.hpp"
+
+namespace sampnode {
+TickStats_t tickstats::stats;
+uint64_t tickstats::overrunThresholdNs = 5000000;
+
+namespace {
+// written on the server thread, read from JS which may run on its own thread
+std::mutex intervalsMutex;
+TickIntervals_t intervals;
+std::chrono::steady_clock::time_point lastTick;
+// moving average of the spacing, kept across reset() for slack_ns()
+uint64_t expectedIntervalNs = 0;
+
+uint64_t tickGcNs = 0;
+
+uint64_t lastHeapUsed = 0;
+uint64_t lastHeapGcCount = 0;
+
+double jitter_ms(const TickIntervals_t &value) {
+  if (value.count == 0)
+    return 0;
+  double mean = value.sumMs / value.count;
+  double variance = value.sumSqMs / value.count - mean * mean;
+  return variance > 0 ? std::sqrt(variance) : 0;
+}
+} // namespace
+
+void tickstats::record(bool idle, uint64_t elapsedNs) {
+  stats.ticks++;
+  if (idle) {
+    stats.idleTicks++;
+    stats.idleNs += elapsedNs;
+  } else {
+    stats.busyNs += elapsedNs;
+  }
+  if (elapsedNs > stats.maxTickNs)
+    stats.maxTickNs = elapsedNs;
+
+  if (elapsedNs > overrunThresholdNs) {
+    stats.overrunTicks++;
+    if (tickGcNs > 0) {
+      stats.overrunTicksWithGc++;
+      stats.overrunGcNs += tickGcNs;
+    }
+  }
+  tickGcNs = 0;
+}
+
+void tickstats::record_gc(uint64_t pauseNs, bool major, bool idleTime) {
+  stats.gcCount++;
+  if (major)
+    stats.majorGcCount++;
+  stats.gcPauseNs += pauseNs;
+  if (pauseNs > stats.maxGcPauseNs)
+    stats.maxGcPauseNs = pauseNs;
+  if (!idleTime)
+    tickGcNs += pauseNs;
+}
+
+void tickstats::record_idle_gc(uint64_t elapsedNs) {
+  stats.idleGcTicks++;
+  stats.idleGcNs += elapsedNs;
+}
+
+void tickstats::record_heap(uint64_t usedBytes, uint64_t limitBytes,
+                            uint64_t externalBytes) {
+  if (lastHeapUsed != 0 && lastHeapGcCount == stats.gcCount &&
+      usedBytes > lastHeapUsed) {
+    uint64_t growth = usedBytes - lastHeapUsed;
+    stats.heapGrowthBytes += growth;
+    if (growth > stats.maxHeapGrowthBytes)
+      stats.maxHeapGrowthBytes = growth;
+  }
+  lastHeapUsed = usedBytes;
+  lastHeapGcCount = stats.gcCount;
+
+  stats.heapUsedBytes = usedBytes;
+  stats.heapLimitBytes = limitBytes;
+  stats.externalBytes = externalBytes;
+}
+
+void tickstats::record_interval() {
+  auto now = std::chrono::steady_clock::now();
+  std::lock_guard<std::mutex> lock(intervalsMutex);
+
+  if (lastTick.time_since_epoch().count() != 0) {
+    double ms =
+        std::chrono::duration<double, std::milli>(now - lastTick).count();
+    intervals.count++;
+    intervals.sumMs += ms;
+    intervals.sumSqMs += ms * ms;
+    if (ms > intervals.maxMs)
+      intervals.maxMs = ms;
+
+    auto ns = static_cast<int64_t>(ms * 1e6);
+    if (expectedIntervalNs == 0)
+      expectedIntervalNs = ns;
+    else
+      expectedIntervalNs += (ns - static_cast<int64_t>(expectedIntervalNs)) / 8;
+  }
+  lastTick = now;
+}
+
+uint64_t tickstats::slack_ns() {
+  if (expectedIntervalNs == 0)
+    return 0;
+
+  auto spent = std::chrono::duration_cast<std::chrono::nanoseconds>(
+                   std::chrono::steady_clock::now() - lastTick)
+                   .count();
+  return spent < static_cast<int64_t>(expectedIntervalNs)
+             ? expectedIntervalNs - spent
+             : 0;
+}
+
+void tickstats::reset() {
+  stats = TickStats_t();
+  lastHeapGcCount = 0;
+
+  std::lock_guard<std::mutex> lock(intervalsMutex);
+  intervals = TickIntervals_t();
+}
+
+void tickstats::log_summary() {
+  if (stats.ticks == 0)
+    return;
+
+  uint64_t busyTicks = stats.ticks - stats.idleTicks;
+  L_INFO << "tick stats: " << stats.ticks << " ticks, " << stats.idleTicks
+         << " idle (" << (stats.idleTicks * 100 / stats.ticks) << "%), avg "
+         << (busyTicks ? stats.busyNs / busyTicks / 1000 : 0) << "us busy / "
+         << (stats.idleTicks ? stats.idleNs / stats.idleTicks : 0)
+         << "ns idle, max " << stats.maxTickNs / 1000 << "us";
+
+  if (stats.gcCount > 0)
+    L_INFO << "gc: " << stats.gcCount << " pauses (" << stats.majorGcCount
+           << " major), " << stats.gcPauseNs / 1000000 << "ms total, max "
+           << stats.maxGcPauseNs / 1000 << "us, " << stats.overrunTicksWithGc
+           << " of " << stats.overrunTicks << " overrun ticks had a pause, "
+           << stats.idleGcTicks << " idle gc ticks";
+
+  if (stats.heapLimitBytes > 0)
+    L_INFO << "heap: " << stats.heapUsedBytes / 1024 << " KB of "
+           << stats.heapLimitBytes / 1024 / 1024 << " MB used, "
+           << stats.externalBytes / 1024 << " KB external, grew "
+           << stats.heapGrowthBytes / 1024 / 1024 << " MB between GCs, max "
+           << stats.maxHeapGrowthBytes / 1024 << " KB in one tick";
+
+  std::lock_guard<std::mutex> lock(intervalsMutex);
+  if (intervals.count == 0)
+    return;
+
+  L_INFO << "tick interval: avg " << intervals.sumMs / intervals.count
+         << "ms, jitter " << jitter_ms(intervals) << "ms, max "
+         << intervals.maxMs << "ms";
+}
+
+void tickstats::get(const v8::FunctionCallbackInfo<v8::Value> &info) {
+  v8::Isolate *isolate = info.GetIsolate();
+  v8::HandleScope scope(isolate);
+  v8::Local<v8::Context> context = isolate->GetCurrentContext();
+
+  v8::Local<v8::Object> result = v8::Object::New(isolate);
+  auto set = [&](const char *key, double value) {
+    result
+        ->Set(context, v8::String::NewFromUtf8(isolate, key).ToLocalChecked(),
+              v8::Number::New(isolate, value))
+        .Check();
+  };
+
+  set("ticks", static_cast<double>(stats.ticks));
+  set("idleTicks", static_cast<double>(stats.idleTicks));
+  set("busyTimeMs", stats.busyNs / 1e6);
+  set("idleTimeMs", stats.idleNs / 1e6);
+  set("maxTickTimeMs", stats.maxTickNs / 1e6);
+  set("gcCount", static_cast<double>(stats.gcCount));
+  set("majorGcCount", static_cast<double>(stats.majorGcCount));
+  set("gcPauseMs", stats.gcPauseNs / 1e6);
+  set("maxGcPauseMs", stats.maxGcPauseNs / 1e6);
+  set("overrunTicks", static_cast<double>(stats.overrunTicks));
+  set("overrunTicksWithGc", static_cast<double>(stats.overrunTicksWithGc));
+  set("overrunGcMs", stats.overrunGcNs / 1e6);
+  set("idleGcTicks", static_cast<double>(stats.idleGcTicks));
+  set("idleGcMs", stats.idleGcNs / 1e6);
+  set("heapUsedBytes", static_cast<double>(stats.heapUsedBytes));
+  set("heapLimitBytes", static_cast<double>(stats.heapLimitBytes));
+  set("externalBytes", static_cast<double>(stats.externalBytes));
+  set("heapGrowthBytes", static_cast<double>(stats.heapGrowthBytes));
+  set("maxHeapGrowthBytes", static_cast<double>(stats.maxHeapGrowthBytes));
+
+  {
+    std::lock_guard<std::mutex> lock(intervalsMutex);
+    set("intervalAvgMs",
+        intervals.count ? intervals.sumMs / intervals.count : 0);
+    set("intervalJitterMs", jitter_ms(intervals));
+    set("maxIntervalMs", intervals.maxMs);
+  }
+
+  if (info.Length() > 0 && info[0]->IsTrue())
+    reset();
+
+  info.GetReturnValue().Set(result);
+}
+} // namespace sampnode
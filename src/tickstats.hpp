@@ -0,0 +1,63 @@
+#pragma once
+#include <chrono>
+#include <cstdint>
+
+#include "node.h"
+#include "v8.h"
+
+namespace sampnode {
+struct TickStats_t {
+  uint64_t ticks = 0;     // every NodeImpl::Tick call
+  uint64_t idleTicks = 0; // ticks that found nothing to do and skipped uv_run
+  uint64_t busyNs = 0;    // time spent in ticks that entered the loop
+  uint64_t idleNs = 0;    // time spent in ticks that were skipped
+  uint64_t maxTickNs = 0;
+
+  uint64_t gcCount = 0;
+  uint64_t majorGcCount = 0;
+  uint64_t gcPauseNs = 0;
+  uint64_t maxGcPauseNs = 0;
+  uint64_t overrunTicks = 0;       // ticks longer than tick_overrun_ms
+  uint64_t overrunTicksWithGc = 0; // overruns that contained a GC pause
+  uint64_t overrunGcNs = 0;        // GC time inside those overruns
+  uint64_t idleGcTicks = 0;        // ticks whose slack was handed to V8
+  uint64_t idleGcNs = 0;
+
+  uint64_t heapUsedBytes = 0; // after the last tick
+  uint64_t heapLimitBytes = 0;
+  uint64_t externalBytes = 0;      // ArrayBuffers and other off-heap memory
+  uint64_t heapGrowthBytes = 0;    // summed over ticks without a GC
+  uint64_t maxHeapGrowthBytes = 0; // largest growth from one tick to the next
+};
+
+// Spacing between consecutive ProcessTick calls on the server thread, the
+// jitter here is what players notice when GC or pool threads steal its core.
+struct TickIntervals_t {
+  uint64_t count = 0;
+  double sumMs = 0;
+  double sumSqMs = 0;
+  double maxMs = 0;
+};
+
+namespace tickstats {
+extern TickStats_t stats;
+extern uint64_t overrunThresholdNs;
+
+void record(bool idle, uint64_t elapsedNs);
+void record_interval();
+// Time left until the next ProcessTick, judged from the start of the current
+// one and the recent spacing of ticks. 0 until that spacing is known.
+uint64_t slack_ns();
+// GC pauses since the last record() are attributed to that tick, unless they
+// happened in idle time the plugin handed to V8 on purpose
+void record_gc(uint64_t pauseNs, bool major, bool idleTime);
+void record_idle_gc(uint64_t elapsedNs);
+// Heap size at the end of a tick. Growth between two ticks without a GC in
+// between is what the events and timers of that tick allocated.
+void record_heap(uint64_t usedBytes, uint64_t limitBytes,
+                 uint64_t externalBytes);
+void reset();
+void log_summary();
+void get(const v8::FunctionCallbackInfo<v8::Value> &info);
+} // namespace tickstats
+} // namespace sampnode
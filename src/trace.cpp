@@ -0,0 +1,206 @@
+#include "trace.hpp"
+
+#include <algorithm>
+#include <cstring>
+#include <fstream>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+#include "utils.hpp"
+
+namespace sampnode {
+namespace trace {
+std::atomic<bool> enabled{false};
+
+namespace {
+struct Event_t {
+  uint64_t startNs;
+  uint64_t durationNs;
+  char name[47];
+  Category category;
+};
+
+// Overwrites its oldest spans once full, a trace keeps the latest ones.
+struct Ring_t {
+  std::unique_ptr<Event_t[]> events;
+  size_t capacity = 0;
+  std::atomic<size_t> head{0};
+  // head when the current trace was started
+  std::atomic<size_t> first{0};
+  int tid = 0;
+  std::string threadName;
+};
+
+size_t ringCapacity = 65536;
+uint64_t traceStartNs = 0;
+
+std::mutex registryMutex;
+std::vector<std::unique_ptr<Ring_t>> rings;
+
+thread_local Ring_t *threadRing = nullptr;
+thread_local const char *threadName = nullptr;
+
+const char *category_name(Category category) {
+  switch (category) {
+  case Category::Tick:
+    return "tick";
+  case Category::Native:
+    return "native";
+  case Category::Public:
+    return "public";
+  case Category::Event:
+    return "event";
+  case Category::Gc:
+    return "gc";
+  }
+  return "";
+}
+
+Ring_t *get_ring() {
+  if (threadRing != nullptr)
+    return threadRing;
+
+  std::lock_guard<std::mutex> lock(registryMutex);
+  auto ring = std::make_unique<Ring_t>();
+  ring->events.reset(new Event_t[ringCapacity]);
+  ring->capacity = ringCapacity;
+  ring->tid = static_cast<int>(rings.size()) + 1;
+  ring->threadName = threadName != nullptr
+                         ? threadName
+                         : "thread " + std::to_string(ring->tid);
+  threadRing = ring.get();
+  rings.push_back(std::move(ring));
+  return threadRing;
+}
+} // namespace
+
+void record(Category category, const char *name, uint64_t startNs,
+            uint64_t endNs) {
+  Ring_t *ring = get_ring();
+  size_t head = ring->head.load(std::memory_order_relaxed);
+
+  Event_t &event = ring->events[head % ring->capacity];
+  event.startNs = startNs;
+  event.durationNs = endNs - startNs;
+  event.category = category;
+  std::strncpy(event.name, name != nullptr ? name : "", sizeof(event.name));
+  event.name[sizeof(event.name) - 1] = '\0';
+
+  ring->head.store(head + 1, std::memory_order_release);
+}
+
+void set_thread_name(const char *name) {
+  threadName = name;
+  if (threadRing != nullptr) {
+    std::lock_guard<std::mutex> lock(registryMutex);
+    threadRing->threadName = name;
+  }
+}
+
+void init(const Props_t &config) {
+  if (config.trace_buffer_size > 0)
+    ringCapacity = static_cast<size_t>(config.trace_buffer_size);
+}
+
+bool start() {
+  if (enabled)
+    return false;
+
+  std::lock_guard<std::mutex> lock(registryMutex);
+  for (auto &ring : rings)
+    ring->first = ring->head.load(std::memory_order_acquire);
+  traceStartNs = now_ns();
+  enabled = true;
+
+  L_INFO << "trace started";
+  return true;
+}
+
+std::string stop(const std::string &path) {
+  if (!enabled.exchange(false))
+    return "";
+
+  json events = json::array();
+  {
+    std::lock_guard<std::mutex> lock(registryMutex);
+    for (auto &ring : rings) {
+      events.push_back({{"name", "thread_name"},
+                        {"ph", "M"},
+                        {"pid", 1},
+                        {"tid", ring->tid},
+                        {"args", {{"name", ring->threadName}}}});
+
+      size_t head = ring->head.load(std::memory_order_acquire);
+      size_t first = ring->first.load();
+      if (head - first > ring->capacity)
+        first = head - ring->capacity;
+
+      // Spans begun before the trace stopped are still being recorded and
+      // may wrap over the slots while they are copied. A copied slot is only
+      // kept if the writer cannot have reached it by the time the copy was
+      // done: the writer may be filling slot `written`, which held index
+      // written - capacity.
+      std::vector<Event_t> copied(head - first);
+      for (size_t i = first; i < head; i++)
+        copied[i - first] = ring->events[i % ring->capacity];
+      std::atomic_thread_fence(std::memory_order_acquire);
+      size_t written = ring->head.load(std::memory_order_relaxed);
+      size_t valid = first;
+      if (written + 1 > ring->capacity)
+        valid = std::max(valid, written + 1 - ring->capacity);
+
+      for (size_t i = valid; i < head; i++) {
+        const Event_t &event = copied[i - first];
+        if (event.startNs < traceStartNs)
+          continue;
+
+        events.push_back({{"name", event.name},
+                          {"cat", category_name(event.category)},
+                          {"ph", "X"},
+                          {"ts", (event.startNs - traceStartNs) / 1e3},
+                          {"dur", event.durationNs / 1e3},
+                          {"pid", 1},
+                          {"tid", ring->tid}});
+      }
+    }
+  }
+
+  std::ofstream file(path, std::ofstream::out | std::ofstream::trunc);
+  if (!file.is_open()) {
+    L_ERROR << "Unable to write trace " << path;
+    return "";
+  }
+
+  // names are copied into fixed buffers, a cut may split a UTF-8 sequence
+  file << json{{"traceEvents", events}, {"displayTimeUnit", "ms"}}.dump(
+      -1, ' ', false, json::error_handler_t::replace);
+  L_INFO << "trace written to " << path;
+  return path;
+}
+
+void js_start(const v8::FunctionCallbackInfo<v8::Value> &info) {
+  info.GetReturnValue().Set(start());
+}
+
+void js_stop(const v8::FunctionCallbackInfo<v8::Value> &info) {
+  v8::Isolate *isolate = info.GetIsolate();
+  v8::HandleScope scope(isolate);
+
+  std::string path;
+  if (info.Length() > 0 && info[0]->IsString())
+    path = utils::js_to_string(isolate, info[0]);
+  if (path.empty())
+    path = utils::timestamped_file(".trace.json");
+
+  path = stop(path);
+  if (path.empty()) {
+    info.GetReturnValue().SetNull();
+    return;
+  }
+
+  info.GetReturnValue().Set(
+      v8::String::NewFromUtf8(isolate, path.c_str()).ToLocalChecked());
+}
+} // namespace trace
+} // namespace sampnode
@@ -0,0 +1,63 @@
+#pragma once
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <string>
+
+#include "config.hpp"
+#include "node.h"
+#include "v8.h"
+
+namespace sampnode {
+namespace trace {
+enum class Category : uint8_t { Tick, Native, Public, Event, Gc };
+
+// Spans are only taken while a trace is being recorded.
+extern std::atomic<bool> enabled;
+
+inline uint64_t now_ns() {
+  return std::chrono::duration_cast<std::chrono::nanoseconds>(
+             std::chrono::steady_clock::now().time_since_epoch())
+      .count();
+}
+
+// Appends a finished span to the ring of the calling thread. Each thread
+// writes only its own ring, so recording takes no lock.
+void record(Category category, const char *name, uint64_t startNs,
+            uint64_t endNs);
+
+class Span {
+public:
+  Span(Category category, const char *name)
+      : category(category), name(name) {
+    if (enabled.load(std::memory_order_relaxed))
+      start = now_ns();
+  }
+
+  ~Span() {
+    if (start != 0)
+      record(category, name, start, now_ns());
+  }
+
+  Span(const Span &) = delete;
+  Span &operator=(const Span &) = delete;
+
+private:
+  Category category;
+  const char *name;
+  uint64_t start = 0;
+};
+
+// shown as the track name in the trace viewer
+void set_thread_name(const char *name);
+
+void init(const Props_t &config);
+bool start();
+// writes the spans since start() as Chrome trace event JSON, empty on failure
+std::string stop(const std::string &path);
+
+// samp.trace.start() and samp.trace.stop([path])
+void js_start(const v8::FunctionCallbackInfo<v8::Value> &info);
+void js_stop(const v8::FunctionCallbackInfo<v8::Value> &info);
+} // namespace trace
+} // namespace sampnode
@@ -1,6 +1,9 @@
 #pragma once
 #include <amx/amx.h>
 
+#include <chrono>
+#include <ctime>
+#include <iomanip>
 #include <sstream>
 #include <string>
 #include <utility>
@@ -40,6 +43,17 @@ inline std::vector<std::string> split(const std::string &s, char delimiter) {
   return tokens;
 }
 
+// output file next to samp-node.log, like samp-node-20240131-235959.trace.json
+inline std::string timestamped_file(const std::string &extension) {
+  auto time =
+      std::chrono::system_clock::to_time_t(std::chrono::system_clock::now());
+  auto tm = *std::localtime(&time);
+
+  std::ostringstream path;
+  path << "samp-node-" << std::put_time(&tm, "%Y%m%d-%H%M%S") << extension;
+  return path.str();
+}
+
 inline cell *get_amxaddr(AMX *amx, cell amx_addr) {
   return (cell *)(amx->base + (int)(((AMX_HEADER *)amx->base)->dat + amx_addr));
 }
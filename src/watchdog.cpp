@@ -0,0 +1,214 @@
+#include "watchdog.hpp"
+
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstdio>
+#include <mutex>
+#include <sstream>
+#include <string>
+#include <thread>
+
+namespace sampnode {
+namespace watchdog {
+namespace {
+constexpr int kMaxFrames = 32;
+
+v8::Isolate *watchedIsolate = nullptr;
+bool enabled = false;
+bool terminate = false;
+cell terminatedRetval = 0;
+uint64_t deadlineNs = 0;
+
+std::thread thread;
+std::mutex threadMutex;
+std::condition_variable threadCv;
+bool running = false;
+
+// only touched by the thread running JS
+int depth = 0;
+// open Tick scopes, outer or nested in an event that waits on a promise
+int tickDepth = 0;
+Kind currentKind = Kind::Tick;
+const char *currentName = nullptr;
+Kind outerKind = Kind::Tick;
+
+// copy of the current name for the watchdog thread
+std::mutex labelMutex;
+char label[96] = {0};
+
+// start of the outermost scope, 0 while no JS runs
+std::atomic<uint64_t> armedAt{0};
+std::atomic<uint64_t> currentGeneration{0};
+std::atomic<uint64_t> interruptGeneration{0};
+std::atomic<uint64_t> terminatedGeneration{0};
+
+uint64_t now_ns() {
+  return std::chrono::duration_cast<std::chrono::nanoseconds>(
+             std::chrono::steady_clock::now().time_since_epoch())
+      .count();
+}
+
+const char *kind_name(Kind kind) {
+  switch (kind) {
+  case Kind::Event:
+    return "event";
+  case Kind::Tick:
+    return "tick";
+  case Kind::Native:
+    return "native";
+  case Kind::Public:
+    return "public";
+  }
+  return "";
+}
+
+void set_label(Kind kind, const char *name) {
+  std::lock_guard<std::mutex> lock(labelMutex);
+  std::snprintf(label, sizeof(label), "%s %s", kind_name(kind),
+                name != nullptr ? name : "");
+}
+
+std::string get_label() {
+  std::lock_guard<std::mutex> lock(labelMutex);
+  return label;
+}
+
+// runs on the JS thread, at the next interrupt check of the running code
+void on_interrupt(v8::Isolate *isolate, void *data) {
+  uint64_t gen = interruptGeneration.load();
+  if (armedAt.load() == 0 || currentGeneration.load() != gen)
+    return;
+
+  v8::HandleScope scope(isolate);
+  v8::Local<v8::StackTrace> trace =
+      v8::StackTrace::CurrentStackTrace(isolate, kMaxFrames);
+
+  std::ostringstream stack;
+  for (int i = 0; i < trace->GetFrameCount(); i++) {
+    v8::Local<v8::StackFrame> frame = trace->GetFrame(isolate, i);
+    v8::String::Utf8Value function(isolate, frame->GetFunctionName());
+    v8::String::Utf8Value script(isolate, frame->GetScriptName());
+    stack << "\n    at "
+          << (function.length() > 0 ? *function : "<anonymous>") << " ("
+          << (script.length() > 0 ? *script : "<unknown>") << ":"
+          << frame->GetLineNumber() << ":" << frame->GetColumn() << ")";
+  }
+
+  L_ERROR << "watchdog: stack of the slow " << get_label() << ":"
+          << (trace->GetFrameCount() > 0 ? stack.str() : " <no JS frames>");
+
+  // ticks run node internals that are not safe to abort halfway, also when
+  // an event ticks the loop itself while it waits on a promise
+  if (terminate && outerKind == Kind::Event && tickDepth == 0) {
+    terminatedGeneration = gen;
+    isolate->TerminateExecution();
+  }
+}
+
+void run() {
+  uint64_t reportedGeneration = 0;
+  auto interval = std::chrono::nanoseconds(deadlineNs / 4);
+  if (interval > std::chrono::milliseconds(100))
+    interval = std::chrono::milliseconds(100);
+
+  std::unique_lock<std::mutex> lock(threadMutex);
+  while (running) {
+    threadCv.wait_for(lock, interval);
+
+    uint64_t start = armedAt.load();
+    uint64_t gen = currentGeneration.load();
+    if (start == 0 || gen == reportedGeneration || armedAt.load() != start)
+      continue;
+
+    uint64_t elapsedNs = now_ns() - start;
+    if (elapsedNs < deadlineNs)
+      continue;
+
+    reportedGeneration = gen;
+    L_WARN << "watchdog: " << get_label() << " has been running for "
+           << elapsedNs / 1000000 << "ms";
+
+    interruptGeneration = gen;
+    watchedIsolate->RequestInterrupt(on_interrupt, nullptr);
+  }
+}
+} // namespace
+
+Scope::Scope(Kind kind, const char *name) {
+  if (!enabled)
+    return;
+
+  active = true;
+  outer = depth++ == 0;
+  tick = kind == Kind::Tick;
+  if (tick)
+    tickDepth++;
+  previousKind = currentKind;
+  previousName = currentName;
+  currentKind = kind;
+  currentName = name;
+  set_label(kind, name);
+
+  if (outer) {
+    outerKind = kind;
+    generation = ++currentGeneration;
+    armedAt = now_ns();
+  }
+}
+
+Scope::~Scope() {
+  if (!active)
+    return;
+
+  depth--;
+  if (tick)
+    tickDepth--;
+  if (outer) {
+    armedAt = 0;
+  } else {
+    currentKind = previousKind;
+    currentName = previousName;
+    set_label(previousKind, previousName);
+  }
+}
+
+bool Scope::Terminated() const {
+  return outer && terminatedGeneration.load() == generation;
+}
+
+void start(v8::Isolate *isolate, const Props_t &config) {
+  if (config.watchdog_timeout_ms <= 0)
+    return;
+
+  watchedIsolate = isolate;
+  deadlineNs = static_cast<uint64_t>(config.watchdog_timeout_ms) * 1000000;
+  terminate = config.watchdog_terminate;
+  terminatedRetval = config.watchdog_retval;
+
+  running = true;
+  enabled = true;
+  thread = std::thread(run);
+
+  L_INFO << "watchdog: reporting JS running longer than "
+         << config.watchdog_timeout_ms << "ms"
+         << (terminate ? ", terminating slow event listeners" : "");
+}
+
+void stop() {
+  if (!enabled)
+    return;
+
+  enabled = false;
+  {
+    std::lock_guard<std::mutex> lock(threadMutex);
+    running = false;
+  }
+  threadCv.notify_all();
+  thread.join();
+  watchedIsolate = nullptr;
+}
+
+cell default_retval() { return terminatedRetval; }
+} // namespace watchdog
+} // namespace sampnode
@@ -0,0 +1,44 @@
+#pragma once
+#include <cstdint>
+
+#include "amx/amx.h"
+#include "config.hpp"
+#include "node.h"
+#include "v8.h"
+
+namespace sampnode {
+namespace watchdog {
+enum class Kind { Event, Tick, Native, Public };
+
+// Marks the thread running JS as busy until destroyed. The outermost scope
+// arms the deadline; nested ones only name what is running inside it, like a
+// native called from an event listener.
+class Scope {
+public:
+  Scope(Kind kind, const char *name);
+  ~Scope();
+
+  Scope(const Scope &) = delete;
+  Scope &operator=(const Scope &) = delete;
+
+  // true when the watchdog terminated JS running under this scope
+  bool Terminated() const;
+
+private:
+  bool active = false;
+  bool outer = false;
+  bool tick = false;
+  uint64_t generation = 0;
+  Kind previousKind = Kind::Tick;
+  const char *previousName = nullptr;
+};
+
+// A thread that logs the JS stack of whatever runs past watchdog_timeout_ms
+// and, with watchdog_terminate, stops event listeners that do.
+void start(v8::Isolate *isolate, const Props_t &config);
+void stop();
+
+// what a terminated event returns to the AMX
+cell default_retval();
+} // namespace watchdog
+} // namespace sampnode
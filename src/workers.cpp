@@ -0,0 +1,236 @@
+#include "workers.hpp"
+
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+
+#include "callbacks.hpp"
+#include "deferred.hpp"
+#include "mpscqueue.hpp"
+#include "natives.hpp"
+#include "nodeimpl.hpp"
+#include "uv.h"
+
+namespace sampnode {
+namespace workers {
+namespace {
+constexpr size_t kQueueCapacity = 16384;
+
+struct Channel_t;
+
+struct Request_t {
+  std::unique_ptr<Deferred_t> call;
+  std::shared_ptr<Channel_t> channel;
+};
+
+// One per worker environment. Everything but the completed list is only
+// touched on the worker thread.
+struct Channel_t {
+  v8::Isolate *isolate = nullptr;
+  uv_async_t wakeup;
+  v8::Global<v8::Context> context;
+  v8::Global<v8::Object> asyncResource;
+  node::async_context asyncContext{};
+
+  uint64_t nextId = 0;
+  std::unordered_map<uint64_t, v8::Global<v8::Promise::Resolver>> pending;
+
+  // guards closed and completed, and keeps wakeup alive while it is signalled
+  std::mutex mutex;
+  bool closed = false;
+  std::vector<Request_t *> completed;
+
+  // released once the wakeup handle has been closed
+  std::shared_ptr<Channel_t> self;
+};
+
+MpscQueue<Request_t *> requestQueue(kQueueCapacity);
+
+void complete(Request_t *request) {
+  std::shared_ptr<Channel_t> channel = request->channel;
+  std::lock_guard<std::mutex> lock(channel->mutex);
+
+  // the worker is gone, nobody is waiting for the result anymore
+  if (channel->closed) {
+    delete request;
+    return;
+  }
+
+  channel->completed.push_back(request);
+  uv_async_send(&channel->wakeup);
+}
+
+void on_wakeup(uv_async_t *handle) {
+  Channel_t *channel = static_cast<Channel_t *>(handle->data);
+
+  std::vector<Request_t *> completed;
+  {
+    std::lock_guard<std::mutex> lock(channel->mutex);
+    completed.swap(channel->completed);
+  }
+
+  v8::Isolate *isolate = channel->isolate;
+  v8::HandleScope scope(isolate);
+  v8::Local<v8::Context> context = channel->context.Get(isolate);
+  v8::Context::Scope contextScope(context);
+  node::CallbackScope callbackScope(
+      isolate, channel->asyncResource.Get(isolate), channel->asyncContext);
+
+  for (Request_t *raw : completed) {
+    std::unique_ptr<Request_t> request(raw);
+
+    auto iter = channel->pending.find(request->call->id);
+    if (iter == channel->pending.end())
+      continue;
+
+    v8::Local<v8::Promise::Resolver> resolver = iter->second.Get(isolate);
+    channel->pending.erase(iter);
+
+    resolver->Resolve(context, request->call->Result(isolate, context))
+        .FromMaybe(false);
+  }
+
+  // let the worker exit once nothing is in flight
+  if (channel->pending.empty())
+    uv_unref(reinterpret_cast<uv_handle_t *>(handle));
+}
+
+void on_cleanup(void *arg) {
+  Channel_t *channel = static_cast<Channel_t *>(arg);
+
+  {
+    std::lock_guard<std::mutex> lock(channel->mutex);
+    channel->closed = true;
+    for (Request_t *request : channel->completed)
+      delete request;
+    channel->completed.clear();
+  }
+
+  node::EmitAsyncDestroy(channel->isolate, channel->asyncContext);
+  channel->pending.clear();
+  channel->asyncResource.Reset();
+  channel->context.Reset();
+
+  uv_close(reinterpret_cast<uv_handle_t *>(&channel->wakeup),
+           [](uv_handle_t *handle) {
+             static_cast<Channel_t *>(handle->data)->self.reset();
+           });
+}
+
+void defer(const v8::FunctionCallbackInfo<v8::Value> &info,
+           std::unique_ptr<Deferred_t> call) {
+  v8::Isolate *isolate = info.GetIsolate();
+  v8::Local<v8::Context> context = isolate->GetCurrentContext();
+  Channel_t *channel =
+      static_cast<Channel_t *>(info.Data().As<v8::External>()->Value());
+
+  v8::Local<v8::Promise::Resolver> resolver =
+      v8::Promise::Resolver::New(context).ToLocalChecked();
+  info.GetReturnValue().Set(resolver->GetPromise());
+
+  // arguments were invalid, settle right away like the sync call would
+  if (!call) {
+    resolver->Resolve(context, v8::Undefined(isolate)).Check();
+    return;
+  }
+
+  call->id = ++channel->nextId;
+  channel->pending.emplace(
+      call->id, v8::Global<v8::Promise::Resolver>(isolate, resolver));
+  if (channel->pending.size() == 1)
+    uv_ref(reinterpret_cast<uv_handle_t *>(&channel->wakeup));
+
+  Request_t *request = new Request_t{std::move(call), channel->self};
+  while (!requestQueue.push(request))
+    std::this_thread::yield();
+}
+
+void call_native(const v8::FunctionCallbackInfo<v8::Value> &info) {
+  defer(info, deferred::native(info, false));
+}
+
+void call_native_float(const v8::FunctionCallbackInfo<v8::Value> &info) {
+  defer(info, deferred::native(info, true));
+}
+
+void call_public(const v8::FunctionCallbackInfo<v8::Value> &info) {
+  defer(info, deferred::public_call(info, false));
+}
+
+void call_public_float(const v8::FunctionCallbackInfo<v8::Value> &info) {
+  defer(info, deferred::public_call(info, true));
+}
+
+void set_function(v8::Local<v8::Context> context, v8::Local<v8::Object> target,
+                  const char *name, v8::FunctionCallback callback,
+                  v8::Local<v8::Value> data) {
+  v8::Isolate *isolate = context->GetIsolate();
+  target
+      ->Set(context, v8::String::NewFromUtf8(isolate, name).ToLocalChecked(),
+            v8::Function::New(context, callback, data).ToLocalChecked())
+      .Check();
+}
+} // namespace
+
+void init_binding(v8::Local<v8::Object> exports, v8::Local<v8::Value> module,
+                  v8::Local<v8::Context> context, void *priv) {
+  v8::Isolate *isolate = context->GetIsolate();
+  bool isWorker = isolate != nodeImpl.GetIsolate();
+
+  exports
+      ->Set(context,
+            v8::String::NewFromUtf8(isolate, "isWorker").ToLocalChecked(),
+            v8::Boolean::New(isolate, isWorker))
+      .Check();
+
+  if (!isWorker) {
+    v8::Local<v8::Value> data;
+    set_function(context, exports, "callNative", native::call, data);
+    set_function(context, exports, "callNativeFloat", native::call_float, data);
+    set_function(context, exports, "callPublic", callback::call, data);
+    set_function(context, exports, "callPublicFloat", callback::call_float,
+                 data);
+    return;
+  }
+
+  auto channel = std::make_shared<Channel_t>();
+  channel->self = channel;
+  channel->isolate = isolate;
+  channel->context.Reset(isolate, context);
+
+  v8::Local<v8::Object> asyncResourceObj = v8::Object::New(isolate);
+  channel->asyncResource.Reset(isolate, asyncResourceObj);
+  channel->asyncContext =
+      node::EmitAsyncInit(isolate, asyncResourceObj, "sampNodeWorkerBridge");
+
+  uv_async_init(node::GetCurrentEventLoop(isolate), &channel->wakeup,
+                on_wakeup);
+  channel->wakeup.data = channel.get();
+  uv_unref(reinterpret_cast<uv_handle_t *>(&channel->wakeup));
+
+  node::AddEnvironmentCleanupHook(isolate, on_cleanup, channel.get());
+
+  v8::Local<v8::Value> data = v8::External::New(isolate, channel.get());
+  set_function(context, exports, "callNative", call_native, data);
+  set_function(context, exports, "callNativeFloat", call_native_float, data);
+  set_function(context, exports, "callPublic", call_public, data);
+  set_function(context, exports, "callPublicFloat", call_public_float, data);
+}
+
+void process_queue() {
+  Request_t *request;
+  while (requestQueue.pop(request)) {
+    request->call->Invoke();
+    complete(request);
+  }
+}
+
+void shutdown() {
+  Request_t *request;
+  while (requestQueue.pop(request))
+    delete request;
+}
+} // namespace workers
+} // namespace sampnode
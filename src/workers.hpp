@@ -0,0 +1,20 @@
+#pragma once
+#include "node.h"
+#include "v8.h"
+
+namespace sampnode {
+namespace workers {
+// Registered as the "samp" linked binding, reachable through
+// process._linkedBinding("samp") on the main thread and in worker threads.
+// Workers get promise based natives and publics which are queued to the
+// server thread, the main thread gets the regular functions.
+void init_binding(v8::Local<v8::Object> exports, v8::Local<v8::Value> module,
+                  v8::Local<v8::Context> context, void *priv);
+
+// server thread, runs queued worker calls and hands the results back
+void process_queue();
+
+// drops calls left over after the runtime has been stopped
+void shutdown();
+} // namespace workers
+} // namespace sampnode
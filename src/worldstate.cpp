@@ -0,0 +1,447 @@
+#include "worldstate.hpp"
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <iterator>
+#include <memory>
+#include <vector>
+
+#include "deferred.hpp"
+#include "jsthread.hpp"
+#include "logger.hpp"
+#include "natives.hpp"
+#include "nodeimpl.hpp"
+#include "sampgdk.h"
+#include "trace.hpp"
+#include "watchdog.hpp"
+
+namespace sampnode {
+namespace worldstate {
+namespace {
+constexpr cell kInvalidPlayerId = 0xFFFF;
+constexpr cell kPlayerStateDriver = 2;
+// the vehicle pool has no native telling its size on servers before 0.3.7
+constexpr int kMaxVehicles = 2000;
+constexpr int kMaxRowValues = 32;
+
+// A field is read by one native taking the id. Values returned through
+// references are floats and take one block per value, the others store the
+// return value of the native. Fields without a native are filled by
+// compute.
+struct Field_t {
+  const char *name;
+  const char *native;
+  int values;
+  bool byRef;
+  cell (*compute)(cell id) = nullptr;
+};
+
+struct Pool_t {
+  const char *name;
+  const Field_t *fields;
+  size_t fieldCount;
+  // highest id in use, falls back to the slot count when missing
+  const char *poolSizeNative;
+  const char *maxSizeNative;
+  int maxSize;
+  // non-zero for ids in use
+  const char *validNative;
+  // runs before the loop when a computed field is selected
+  void (*prepare)(int limit) = nullptr;
+
+  // resolved on the server thread on first use, natives are registered late
+  bool resolved = false;
+  AMX_NATIVE poolSizeAddress = nullptr;
+  AMX_NATIVE maxSizeAddress = nullptr;
+  AMX_NATIVE validAddress = nullptr;
+  std::vector<AMX_NATIVE> natives;
+  std::vector<int> rowOffsets;
+  int rowSize = 0;
+};
+
+const Field_t playerFieldTable[] = {
+    {"position", "GetPlayerPos", 3, true},
+    {"facingAngle", "GetPlayerFacingAngle", 1, true},
+    {"velocity", "GetPlayerVelocity", 3, true},
+    {"health", "GetPlayerHealth", 1, true},
+    {"armour", "GetPlayerArmour", 1, true},
+    {"state", "GetPlayerState", 1, false},
+    {"virtualWorld", "GetPlayerVirtualWorld", 1, false},
+    {"interior", "GetPlayerInterior", 1, false},
+    {"vehicle", "GetPlayerVehicleID", 1, false},
+    {"vehicleSeat", "GetPlayerVehicleSeat", 1, false},
+    {"weapon", "GetPlayerWeapon", 1, false},
+    {"skin", "GetPlayerSkin", 1, false},
+    {"money", "GetPlayerMoney", 1, false},
+    {"score", "GetPlayerScore", 1, false},
+    {"ping", "GetPlayerPing", 1, false},
+    {"specialAction", "GetPlayerSpecialAction", 1, false},
+};
+
+Pool_t players{"snapshotPlayers", playerFieldTable, std::size(playerFieldTable),
+               "GetPlayerPoolSize", "GetMaxPlayers", 0, "IsPlayerConnected"};
+
+// SA-MP has no native for the driver of a vehicle, it is looked up from the
+// players once per snapshot
+std::vector<cell> drivers;
+
+cell vehicle_driver(cell id) {
+  return id < static_cast<cell>(drivers.size()) ? drivers[id]
+                                                : kInvalidPlayerId;
+}
+
+const Field_t vehicleFieldTable[] = {
+    {"position", "GetVehiclePos", 3, true},
+    {"zAngle", "GetVehicleZAngle", 1, true},
+    {"velocity", "GetVehicleVelocity", 3, true},
+    {"health", "GetVehicleHealth", 1, true},
+    {"model", "GetVehicleModel", 1, false},
+    {"virtualWorld", "GetVehicleVirtualWorld", 1, false},
+    {"driver", nullptr, 1, false, vehicle_driver},
+    {"trailer", "GetVehicleTrailer", 1, false},
+};
+
+void find_drivers(int limit);
+
+// GetVehicleModel is 0 for ids not in use and exists on every server
+Pool_t vehicles{"snapshotVehicles", vehicleFieldTable,
+                std::size(vehicleFieldTable), "GetVehiclePoolSize", nullptr,
+                kMaxVehicles, "GetVehicleModel", find_drivers};
+
+const char *const kRefFormats[] = {"i", "iR", "iRR", "iRRR"};
+
+struct Request_t {
+  Pool_t *pool = nullptr;
+  uint32_t fields = 0;
+  std::shared_ptr<v8::BackingStore> store;
+  int capacity = 0;
+  // below zero writes every entry
+  double epsilon = -1;
+  int count = 0;
+};
+
+// What the incremental mode last wrote into one buffer, per id. Keyed by the
+// buffer, so callers don't see each other's changes, and dropped once the
+// buffer is gone, e.g. with its context on a reload.
+struct Baseline_t {
+  std::weak_ptr<v8::BackingStore> store;
+  const Pool_t *pool;
+  uint32_t fields;
+  double epsilon;
+  std::vector<cell> values;
+  std::vector<char> present;
+};
+
+// server thread
+std::vector<Baseline_t> baselines;
+
+Baseline_t &baseline_of(const Request_t &request) {
+  baselines.erase(std::remove_if(baselines.begin(), baselines.end(),
+                                 [](const Baseline_t &baseline) {
+                                   return baseline.store.expired();
+                                 }),
+                  baselines.end());
+
+  for (Baseline_t &baseline : baselines) {
+    if (baseline.store.lock() != request.store)
+      continue;
+    // other fields or another epsilon start over
+    if (baseline.pool != request.pool || baseline.fields != request.fields ||
+        baseline.epsilon != request.epsilon) {
+      baseline.pool = request.pool;
+      baseline.fields = request.fields;
+      baseline.epsilon = request.epsilon;
+      baseline.values.clear();
+      baseline.present.clear();
+    }
+    return baseline;
+  }
+
+  baselines.push_back({request.store, request.pool, request.fields,
+                       request.epsilon, {}, {}});
+  return baselines.back();
+}
+
+void resolve(Pool_t &pool) {
+  if (pool.resolved)
+    return;
+
+  if (pool.poolSizeNative)
+    pool.poolSizeAddress = native::get_address(pool.poolSizeNative);
+  if (pool.maxSizeNative)
+    pool.maxSizeAddress = native::get_address(pool.maxSizeNative);
+  pool.validAddress = native::get_address(pool.validNative);
+
+  for (size_t i = 0; i < pool.fieldCount; i++) {
+    const Field_t &field = pool.fields[i];
+    AMX_NATIVE address = nullptr;
+    if (field.native) {
+      address = native::get_address(field.native);
+      if (!address)
+        L_WARN << pool.name << ": native " << field.native
+               << " not found, the field stays 0";
+    }
+    pool.natives.push_back(address);
+    pool.rowOffsets.push_back(pool.rowSize);
+    pool.rowSize += field.values;
+  }
+  pool.resolved = true;
+}
+
+// ids past the last one that can be in use
+int id_limit(Pool_t &pool) {
+  if (pool.poolSizeAddress)
+    return sampgdk::InvokeNativeArray(pool.poolSizeAddress, "", nullptr) + 1;
+  if (pool.maxSizeAddress)
+    return sampgdk::InvokeNativeArray(pool.maxSizeAddress, "", nullptr);
+  return pool.maxSize;
+}
+
+void find_drivers(int limit) {
+  drivers.assign(limit, kInvalidPlayerId);
+
+  resolve(players);
+  // indices into playerFieldTable
+  AMX_NATIVE state = players.natives[5];
+  AMX_NATIVE vehicle = players.natives[8];
+  if (!players.validAddress || !state || !vehicle)
+    return;
+
+  int playerLimit = id_limit(players);
+  cell id = 0;
+  void *args[] = {&id};
+  for (; id < playerLimit; id++) {
+    if (!sampgdk::InvokeNativeArray(players.validAddress, "i", args) ||
+        sampgdk::InvokeNativeArray(state, "i", args) != kPlayerStateDriver)
+      continue;
+
+    cell vehicleId = sampgdk::InvokeNativeArray(vehicle, "i", args);
+    if (vehicleId > 0 && vehicleId < limit)
+      drivers[vehicleId] = id;
+  }
+}
+
+bool changed(const Field_t &field, const cell *now, const cell *before,
+             double epsilon) {
+  for (int v = 0; v < field.values; v++) {
+    cell a = now[v], b = before[v];
+    if (!field.byRef ? a != b : std::fabs(amx_ctof(a) - amx_ctof(b)) > epsilon)
+      return true;
+  }
+  return false;
+}
+
+// server thread
+void fill(Request_t &request) {
+  Pool_t &pool = *request.pool;
+  trace::Span span(trace::Category::Native, pool.name);
+  resolve(pool);
+  if (!pool.validAddress)
+    return;
+
+  struct Block_t {
+    const Field_t *field;
+    AMX_NATIVE native;
+    int rowOffset;
+    cell *base;
+  };
+
+  const int capacity = request.capacity;
+  const bool incremental = request.epsilon >= 0;
+  cell *ids = static_cast<cell *>(request.store->Data());
+  cell *next = ids + capacity;
+
+  Block_t blocks[kMaxRowValues];
+  int blockCount = 0;
+  bool computed = false;
+  for (size_t i = 0; i < pool.fieldCount; i++) {
+    if ((request.fields & (1u << i)) == 0)
+      continue;
+    blocks[blockCount++] = {&pool.fields[i], pool.natives[i],
+                            pool.rowOffsets[i], next};
+    next += pool.fields[i].values * capacity;
+    computed |= pool.fields[i].compute != nullptr;
+  }
+
+  int limit = id_limit(pool);
+  if (computed && pool.prepare)
+    pool.prepare(limit);
+
+  // ids up to end, past a shrunken pool too, may still have to be reported
+  Baseline_t *baseline = incremental ? &baseline_of(request) : nullptr;
+  int end = limit;
+  if (baseline) {
+    if (static_cast<int>(baseline->present.size()) < limit) {
+      baseline->present.resize(limit, 0);
+      baseline->values.resize(static_cast<size_t>(limit) * pool.rowSize, 0);
+    }
+    end = static_cast<int>(baseline->present.size());
+  }
+
+  int count = 0;
+  cell id = 0;
+  cell values[3];
+  void *args[] = {&id, &values[0], &values[1], &values[2]};
+  cell row[kMaxRowValues];
+
+  for (; id < end && count < capacity; id++) {
+    if (id >= limit ||
+        !sampgdk::InvokeNativeArray(pool.validAddress, "i", args)) {
+      if (!baseline)
+        continue;
+      // gone since the last snapshot, reported as -1 - id
+      if (baseline->present[id]) {
+        ids[count] = -1 - id;
+        for (int b = 0; b < blockCount; b++) {
+          for (int v = 0; v < blocks[b].field->values; v++)
+            blocks[b].base[v * capacity + count] = 0;
+        }
+        count++;
+      }
+      baseline->present[id] = 0;
+      continue;
+    }
+
+    cell *last =
+        baseline ? &baseline->values[static_cast<size_t>(id) * pool.rowSize]
+                 : nullptr;
+    bool dirty = !baseline || !baseline->present[id];
+    for (int b = 0; b < blockCount; b++) {
+      const Block_t &block = blocks[b];
+      const Field_t &field = *block.field;
+      cell *out = row + block.rowOffset;
+
+      if (field.compute) {
+        out[0] = field.compute(id);
+      } else if (!block.native) {
+        std::memset(out, 0, field.values * sizeof(cell));
+      } else if (field.byRef) {
+        sampgdk::InvokeNativeArray(block.native, kRefFormats[field.values],
+                                   args);
+        std::memcpy(out, values, field.values * sizeof(cell));
+      } else {
+        out[0] = sampgdk::InvokeNativeArray(block.native, "i", args);
+      }
+
+      if (!dirty)
+        dirty = changed(field, out, last + block.rowOffset, request.epsilon);
+    }
+
+    if (!dirty)
+      continue;
+
+    // the baseline moves only with what was reported, so slow drift still
+    // adds up to a change
+    ids[count] = id;
+    for (int b = 0; b < blockCount; b++) {
+      const Block_t &block = blocks[b];
+      for (int v = 0; v < block.field->values; v++) {
+        cell value = row[block.rowOffset + v];
+        block.base[v * capacity + count] = value;
+        if (last)
+          last[block.rowOffset + v] = value;
+      }
+    }
+    if (baseline)
+      baseline->present[id] = 1;
+    count++;
+  }
+  request.count = count;
+}
+
+bool prepare(const v8::FunctionCallbackInfo<v8::Value> &info, Pool_t &pool,
+             Request_t &request) {
+  v8::Isolate *isolate = info.GetIsolate();
+  v8::Local<v8::Context> context = isolate->GetCurrentContext();
+
+  if (info.Length() < 2 || !info[0]->IsNumber() ||
+      !(info[1]->IsArrayBuffer() || info[1]->IsSharedArrayBuffer())) {
+    L_ERROR << pool.name << ": expected (fields, buffer, epsilon?)";
+    return false;
+  }
+
+  request.pool = &pool;
+  request.fields = info[0]->Uint32Value(context).FromMaybe(0) &
+                   ((1u << pool.fieldCount) - 1);
+  request.store = info[1]->IsArrayBuffer()
+                      ? info[1].As<v8::ArrayBuffer>()->GetBackingStore()
+                      : info[1].As<v8::SharedArrayBuffer>()->GetBackingStore();
+  if (info.Length() > 2 && info[2]->IsNumber())
+    request.epsilon = info[2]->NumberValue(context).FromMaybe(-1);
+
+  // one block of ids, then one per selected value
+  size_t values = 1;
+  for (size_t i = 0; i < pool.fieldCount; i++) {
+    if (request.fields & (1u << i))
+      values += pool.fields[i].values;
+  }
+  request.capacity =
+      static_cast<int>(request.store->ByteLength() / (values * sizeof(cell)));
+  if (request.capacity == 0) {
+    L_ERROR << pool.name << ": the buffer can't hold a single entry";
+    return false;
+  }
+  return true;
+}
+
+struct DeferredSnapshot_t : Deferred_t {
+  Request_t request;
+
+  void Invoke() override { fill(request); }
+
+  v8::Local<v8::Value> Result(v8::Isolate *isolate,
+                              v8::Local<v8::Context> context) override {
+    return v8::Integer::New(isolate, request.count);
+  }
+};
+
+void snapshot(const v8::FunctionCallbackInfo<v8::Value> &info, Pool_t &pool) {
+  auto task = std::make_unique<DeferredSnapshot_t>();
+  if (!prepare(info, pool, task->request)) {
+    info.GetReturnValue().Set(-1);
+    return;
+  }
+
+  if (jsThread.IsActive()) {
+    jsThread.Defer(info, std::move(task));
+    return;
+  }
+
+  {
+    watchdog::Scope watchdogScope(watchdog::Kind::Native, pool.name);
+    Request_t &request = task->request;
+    nodeImpl.RunOnServerThread([&request] { fill(request); });
+  }
+  info.GetReturnValue().Set(task->request.count);
+}
+
+v8::Local<v8::ObjectTemplate> field_bits(v8::Isolate *isolate,
+                                         const Pool_t &pool) {
+  v8::Local<v8::ObjectTemplate> object = v8::ObjectTemplate::New(isolate);
+  for (size_t i = 0; i < pool.fieldCount; i++) {
+    object->Set(
+        v8::String::NewFromUtf8(isolate, pool.fields[i].name).ToLocalChecked(),
+        v8::Integer::NewFromUnsigned(isolate, 1u << i));
+  }
+  return object;
+}
+} // namespace
+
+void snapshot_players(const v8::FunctionCallbackInfo<v8::Value> &info) {
+  snapshot(info, players);
+}
+
+void snapshot_vehicles(const v8::FunctionCallbackInfo<v8::Value> &info) {
+  snapshot(info, vehicles);
+}
+
+v8::Local<v8::ObjectTemplate> player_fields(v8::Isolate *isolate) {
+  return field_bits(isolate, players);
+}
+
+v8::Local<v8::ObjectTemplate> vehicle_fields(v8::Isolate *isolate) {
+  return field_bits(isolate, vehicles);
+}
+} // namespace worldstate
+} // namespace sampnode
@@ -0,0 +1,21 @@
+#pragma once
+
+#include "node.h"
+#include "v8.h"
+
+namespace sampnode {
+namespace worldstate {
+// samp.snapshotPlayers(fields, buffer[, epsilon]) reads the selected fields of
+// every connected player on the server thread, straight through the natives,
+// into a struct-of-arrays layout in buffer. With epsilon, only the players
+// that changed by more than it since the last snapshot are written. Returns
+// the number of entries written, or a promise of it with threaded_runtime.
+void snapshot_players(const v8::FunctionCallbackInfo<v8::Value> &info);
+// samp.snapshotVehicles(fields, buffer[, epsilon]), the same for vehicles
+void snapshot_vehicles(const v8::FunctionCallbackInfo<v8::Value> &info);
+
+// samp.playerFields and samp.vehicleFields, the bit of each field for the mask
+v8::Local<v8::ObjectTemplate> player_fields(v8::Isolate *isolate);
+v8::Local<v8::ObjectTemplate> vehicle_fields(v8::Isolate *isolate);
+} // namespace worldstate
+} // namespace sampnode